@@ -2,6 +2,7 @@
 #ifndef DOMAINS_IDOMAINSTATEFUL_H_
 #define DOMAINS_IDOMAINSTATEFUL_H_
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <map>
@@ -28,7 +29,21 @@ class IDomainStatefulParameters {
 class IDomainStateful {
  public:
     explicit IDomainStateful(IDomainStatefulParameters *params);
-    ~IDomainStateful(void);    
+    virtual ~IDomainStateful(void);
+
+    //! A replica for another thread: the same world, in its reset() state,
+    //! sharing nothing that simulating either one changes. The caller owns
+    //! it and must synch_step it to a counter of its own. NULL if the
+    //! domain cannot be replicated.
+    virtual IDomainStateful* clone() const { return NULL; }
+
+    //! Whether the domain's draws make an episode one noisy sample of a
+    //! team's fitness (random traffic, say) rather than just breaking
+    //! ties. Assumed so unless a domain says otherwise.
+    virtual bool stochastic() const { return true; }
+    //! Identifies what the domain simulates (modes, map), for results
+    //! reused across episodes (SimNE's fitness cache)
+    virtual uint64_t configurationKey() const { return 0; }
 
     // Returns the state vector for the set of agents, [AGENTID][STATEELEMENT]
     virtual matrix2d getStates() = 0;
@@ -38,6 +53,10 @@ class IDomainStateful {
 
     //! Returns the reward vector for a set of agents [AGENTID]
     virtual matrix1d getRewards() = 0;
+    //! Racing: the most each agent's getRewards could come to by the end
+    //! of the episode, given the steps so far. False if the reward mode
+    //! has no such bound.
+    virtual bool rewardBound(matrix1d*) { return false; }
 
     //! Returns the performance vector for a set of agents
     virtual matrix1d getPerformance() = 0;
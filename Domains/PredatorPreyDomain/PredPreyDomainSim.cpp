@@ -71,7 +71,7 @@ vector<NeuroEvo*> PredPreyDomainSim::getNEForEachPredator(){
 
 void PredPreyDomainSim::addExtraTypeInputs(vector<NeuroEvo*> &NESet){
 	for (int i=0; i<NESet.size(); i++){
-		for (list<NeuralNet*>::iterator j= NESet[i]->population.begin(); j!=NESet[i]->population.end(); j++){
+		for (vector<NeuralNet*>::iterator j= NESet[i]->population.begin(); j!=NESet[i]->population.end(); j++){
 			(*j)->addInputs(Predator::numTypes);
 		}
 	}
@@ -146,7 +146,7 @@ void PredPreyDomainSim::simulatePredPreyEpoch(vector<NeuroEvo*> &NESet, vector<v
 	int numNN = NESet[0]->population.size();
 	vector<vector<NeuralNet*> > NNSets(numNN); // Set to the number of population members
 
-	vector<list<NeuralNet*>::iterator> popMembersInNNSet(NESet.size()); // list of iterators to set members across NE objects
+	vector<vector<NeuralNet*>::iterator> popMembersInNNSet(NESet.size()); // list of iterators to set members across NE objects
 	for (int i=0; i<NESet.size(); i++){ // initialization of iterator list
 		popMembersInNNSet[i]=NESet[i]->population.begin();
 	}
@@ -71,9 +71,9 @@ void PredPreyDomainSimTypeNE::simulatePredPreyTypeNEEpoch(vector<TypeNeuroEvo*>
 	int k = NeuroEvoParameters::popSize;
 	
 	// preprocessing to get neural networks
-	vector<vector<list<NeuralNet*>::iterator> > populationMembersInNNSet(TNESet.size()); // set of iterators to neural networks [predator][neighbortype]
+	vector<vector<vector<NeuralNet*>::iterator> > populationMembersInNNSet(TNESet.size()); // set of iterators to neural networks [predator][neighbortype]
 	for (int i=0; i<TNESet.size(); i++){
-		populationMembersInNNSet[i] = vector<list<NeuralNet*>::iterator>(TNESet[i]->NETypes.size());
+		populationMembersInNNSet[i] = vector<vector<NeuralNet*>::iterator>(TNESet[i]->NETypes.size());
 		for (int j=0; j<TNESet[i]->NETypes.size(); j++){
 			populationMembersInNNSet[i][j] = TNESet[i]->NETypes[j]->population.begin(); // [predator][neighbortype]
 		}
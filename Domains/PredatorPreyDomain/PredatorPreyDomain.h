@@ -1,6 +1,5 @@
 #pragma once
 //#include "../GridWorld/GridWorld.h"
-#include "omp.h"
 #include <time.h>
 #include "../../easymath.h"
 #include "../Point2D.h"
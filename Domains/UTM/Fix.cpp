@@ -13,9 +13,9 @@ using easymath::rand;
 Fix::Fix(XY loc, int ID_set, TypeGraphManager* highGraph,
     vector<XY> dest_locs,
     UTMModes* params,
-    map<edge, int> *linkIDs) :
+    map<edge, int> *linkIDs, int* n_generated) :
     highGraph(highGraph), destination_locs(dest_locs), ID(ID_set),
-    loc(loc), params(params), linkIDs(linkIDs) {
+    loc(loc), params(params), linkIDs(linkIDs), n_generated(n_generated) {
 }
 
 bool Fix::atDestinationFix(const UAV &u) {
@@ -69,16 +69,15 @@ list<UAV* > Fix::generateTraffic(int step) {
 }
 
 UAV* Fix::generate_UAV() {
-    static int calls = 0;
     XY end_loc;
     if (ID == 0)
         end_loc = destination_locs.back();
     else
         end_loc = destination_locs.at(ID - 1);  // go to previous
 
-    // Creates an equal number of each type;
-    int type_id_set = calls%params->get_n_types();
-    calls++;
+    // Creates an equal number of each type; counted per domain and
+    // episode, so an episode repeats on whichever replica runs it
+    int type_id_set = (*n_generated)++ % params->get_n_types();
     UAV* u = new UAV(highGraph->getMembership(loc),
         highGraph->getMembership(end_loc),
         static_cast<UTMModes::UAVType>(type_id_set),
@@ -14,7 +14,7 @@ class Fix {
     Fix(easymath::XY loc, int ID, TypeGraphManager* highGraph,
         std::vector<easymath::XY> dest_locs,
         UTMModes* params,
-        std::map<edge, int> *linkIDs);
+        std::map<edge, int> *linkIDs, int* n_generated);
 
 
     ~Fix() {}
@@ -24,6 +24,9 @@ class Fix {
     int ID;
     easymath::XY loc;
     std::map<edge, int>* linkIDs;
+    //! UAVs made by the domain's fixes this episode, which picks the type
+    //! of the next
+    int* n_generated;
     virtual UAV* generate_UAV();
 
     TypeGraphManager* highGraph;
@@ -38,10 +41,11 @@ class FixDetail : public Fix {
     FixDetail(easymath::XY loc, int ID, TypeGraphManager* highGraph,
         SectorGraphManager* lowGraph,
         std::vector<easymath::XY> dest_locs,
-        UTMModes* params, std::map<std::pair<int, int>, int> *linkIDs) :
+        UTMModes* params, std::map<std::pair<int, int>, int> *linkIDs,
+        int* n_generated) :
         Fix(loc, ID, highGraph,
             dest_locs,
-            params, linkIDs),
+            params, linkIDs, n_generated),
         lowGraph(lowGraph), approach_threshold(params->get_dist_thresh()),
         conflict_threshold(params->get_conflict_thresh())
 
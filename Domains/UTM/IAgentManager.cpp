@@ -1,7 +1,9 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "IAgentManager.h"
+#include <algorithm>
 #include <string>
 #include <vector>
+#include "../../SingleAgent/NeuralNet/StreamingDataset.h"
 
 using std::string;
 using std::vector;
@@ -144,6 +146,40 @@ void IAgentManager::exportAgentActions(int fileID) {
     FileOut::print_vector(agentStates, statefile);
 }
 
+void IAgentManager::exportAgentTrace(int fileID) {
+    size_t n_steps = std::min(agentStates.size(), agentActions.size());
+    if (n_steps == 0 || agentStates[0].empty() || agentActions[0].empty())
+        return;
+
+    // check every record before writing, so the file is never left half
+    // written by DatasetWriter::append stopping on a mismatch
+    size_t n_inputs = agentStates[0][0].size();
+    size_t n_outputs = agentActions[0][0].size();
+    for (size_t step = 0; step < n_steps; step++) {
+        bool match = agentStates[step].size() == agentActions[step].size();
+        for (size_t a = 0; match && a < agentStates[step].size(); a++) {
+            match = agentStates[step][a].size() == n_inputs
+                && agentActions[step][a].size() == n_outputs;
+        }
+        if (!match) {
+            printf("IAgentManager: states and actions of step %i do not ",
+                static_cast<int>(step));
+            printf("match; no trace written.");
+            system("pause");
+            exit(1);
+        }
+    }
+
+    string tracefile = "trace-" + std::to_string(fileID) + ".bin";
+    DatasetWriter trace(tracefile, static_cast<int>(n_inputs),
+        static_cast<int>(n_outputs), true);
+    for (size_t step = 0; step < n_steps; step++) {
+        for (size_t a = 0; a < agentStates[step].size(); a++) {
+            trace.append(agentStates[step][a], agentActions[step][a]);
+        }
+    }
+}
+
 void IAgentManager::reset() {
     agentActions.clear();
     agentStates.clear();
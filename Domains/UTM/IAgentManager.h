@@ -74,6 +74,11 @@ class IAgentManager {
     //! Exports list of agent actions to a numbered file.
     void exportAgentActions(int fileID);
 
+    //! Appends one record per step and agent (its state, then its action)
+    //! to the numbered binary trace trace-<fileID>.bin, which
+    //! StreamingDataset can train on without loading it.
+    void exportAgentTrace(int fileID);
+
 
     struct Reward_Metrics {
         /**
@@ -1,5 +1,6 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "UAV.h"
+#include <atomic>
 #include <map>
 #include <list>
 #include <vector>
@@ -20,7 +21,8 @@ UAV::UAV(int start_mem, int mem_end, UTMModes::UAVType my_type,
     type(my_type), speed(1.0),
     linkIDs(linkIDs),
     params(params) {
-    static int calls = 0;
+    // domain replicas make UAVs on several threads
+    static std::atomic<int> calls(0);
     ID = calls++;
 
     // Get initial plan and update
@@ -1,9 +1,11 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "UTMDomainAbstract.h"
+#include <cstring>
 #include <vector>
 #include <string>
 #include <list>
 #include <map>
+#include "../../Parallel/ThreadPool.h"
 
 using std::list;
 using std::vector;
@@ -14,7 +16,12 @@ using std::map;
 using easymath::zeros;
 
 UTMDomainAbstract::UTMDomainAbstract(UTMModes* params_set) :
-    IDomainStateful(params_set) {
+    UTMDomainAbstract(params_set, NULL) {
+}
+
+UTMDomainAbstract::UTMDomainAbstract(UTMModes* params_set,
+    TypeGraphManager* airspace) :
+    IDomainStateful(params_set), n_uavs_generated(0) {
     filehandler = new UTMFileNames(params_set),
         params = params_set;
 
@@ -24,7 +31,11 @@ UTMDomainAbstract::UTMDomainAbstract(UTMModes* params_set) :
     ifstream edgefile(domain_dir + "edges.csv");
     bool fileExists = edgefile.good();
     edgefile.close();
-    if (params->_airspace_mode == UTMModes::AirspaceMode::SAVED && fileExists) {
+    if (airspace) {
+        highGraph = airspace;
+        n_sectors = highGraph->getNVertices();
+    } else if (params->_airspace_mode == UTMModes::AirspaceMode::SAVED
+        && fileExists) {
         highGraph = new TypeGraphManager(domain_dir + "edges.csv",
             domain_dir + "nodes.csv", n_types);
         n_sectors = highGraph->getNVertices();
@@ -90,7 +101,51 @@ UTMDomainAbstract::UTMDomainAbstract(UTMModes* params_set) :
     for (Sector* s : sectors)
         s->generation_pt = new Fix(s->xy, s->ID, highGraph,
             sector_locs,
-            params, linkIDs);
+            params, linkIDs, &n_uavs_generated);
+}
+
+IDomainStateful* UTMDomainAbstract::clone() const {
+    return new UTMDomainAbstract(params, copyAirspace());
+}
+
+TypeGraphManager* UTMDomainAbstract::copyAirspace() const {
+    // rebuilt from its sector locations and edges, so that no new
+    // airspace is drawn
+    vector<XY> locs;
+    for (int i = 0; i < highGraph->getNVertices(); i++) {
+        locs.push_back(highGraph->getLocation(i));
+    }
+    return new TypeGraphManager(n_types, highGraph->getEdges(), locs);
+}
+
+uint64_t UTMDomainAbstract::configurationKey() const {
+    using easymath::hash_combine;
+    uint64_t alpha_bits;
+    std::memcpy(&alpha_bits, &params->alpha, sizeof(alpha_bits));
+    uint64_t parts[] = {
+        static_cast<uint64_t>(params->_reward_mode),
+        static_cast<uint64_t>(params->_reward_type_mode),
+        static_cast<uint64_t>(params->_traffic_mode),
+        static_cast<uint64_t>(params->_agent_defn_mode),
+        static_cast<uint64_t>(params->_search_type_mode),
+        static_cast<uint64_t>(params->_disposal_mode),
+        params->square_reward, alpha_bits,
+        static_cast<uint64_t>(params->get_n_sectors()),
+        static_cast<uint64_t>(n_steps)
+    };
+    uint64_t key = 0;
+    for (uint64_t p : parts) key = hash_combine(key, p);
+    for (int i = 0; i < highGraph->getNVertices(); i++) {
+        XY loc = highGraph->getLocation(i);
+        uint64_t x, y;
+        std::memcpy(&x, &loc.x, sizeof(x));
+        std::memcpy(&y, &loc.y, sizeof(y));
+        key = hash_combine(hash_combine(key, x), y);
+    }
+    for (const edge &e : highGraph->getEdges()) {
+        key = hash_combine(hash_combine(key, e.first), e.second);
+    }
+    return key;
 }
 
 string UTMDomainAbstract::createExperimentDirectory() {
@@ -125,6 +180,14 @@ matrix1d UTMDomainAbstract::getRewards() {
     return agents->reward();
 }
 
+bool UTMDomainAbstract::rewardBound(matrix1d* R) {
+    if (params->_reward_mode != UTMModes::RewardMode::GLOBAL
+        || params->square_reward)
+        return false;
+    *R = agents->global();
+    return true;
+}
+
 
 void UTMDomainAbstract::incrementUAVPath() {
 	for (size_t i = 0; i < links.size(); i++) {
@@ -180,7 +243,7 @@ void UTMDomainAbstract::incrementUAVPath() {
 }
 
 void UTMDomainAbstract::try_to_move(vector<UAV*> * eligible_to_move) {
-    random_shuffle(eligible_to_move->begin(), eligible_to_move->end());
+    easymath::shuffle(eligible_to_move->begin(), eligible_to_move->end());
 
     size_t el_size;
     do {
@@ -483,19 +546,33 @@ void UTMDomainAbstract::detectConflicts() {
 }
 
 void UTMDomainAbstract::getPathPlans() {
+    planning_.clear();
     for (UAV* u : UAVs) {
         if (u->t <= 0)  // enforces commitment to link
-            u->planAbstractPath();
+            planning_.push_back(u);
     }
+    planPaths();
 }
 
 void UTMDomainAbstract::getPathPlans(const std::list<UAV* > &new_UAVs) {
-    for (UAV* u : new_UAVs) {
-        u->planAbstractPath();  // sets own next waypoint
+    planning_.assign(new_UAVs.begin(), new_UAVs.end());
+    planPaths();
+}
+
+void UTMDomainAbstract::planPaths() {
+    // A* only reads the graph, so the UAVs can plan at once; RAGS keeps
+    // its search state in the airspace
+    if (params->_search_type_mode != UTMModes::SearchDefinition::ASTAR) {
+        for (UAV* u : planning_) u->planAbstractPath();
+        return;
     }
+    parallel::parallel_for(0, planning_.size(), 8, [this](size_t i) {
+        planning_[i]->planAbstractPath();  // sets own next waypoint
+    });
 }
 
 void UTMDomainAbstract::reset() {
+    n_uavs_generated = 0;
     while (!UAVs.empty()) {
         delete UAVs.back();
         UAVs.pop_back();
@@ -25,6 +25,20 @@ class UTMDomainAbstract :
     explicit UTMDomainAbstract(UTMModes* params);
     ~UTMDomainAbstract(void);
 
+    //! Same airspace and parameters, with sectors, links, agents and
+    //! traffic of its own
+    virtual IDomainStateful* clone() const;
+    //! Stochastic under PROBABILISTIC traffic; the key covers the modes,
+    //! constants and airspace
+    virtual bool stochastic() const {
+        return params->_traffic_mode == UTMModes::TrafficMode::PROBABILISTIC;
+    }
+    virtual uint64_t configurationKey() const;
+    //! Delays and conflicts only accumulate, so the global reward so far
+    //! bounds the final one. Difference rewards and squared rewards have
+    //! no such bound.
+    virtual bool rewardBound(matrix1d* R);
+
     // virtual void initialize(UTMModes* params);
 
     virtual void synch_step(int* step_set) {
@@ -49,6 +63,8 @@ class UTMDomainAbstract :
 
     // Traffic
     std::list<UAV*> UAVs;
+    //! UAVs the fixes have made this episode
+    int n_uavs_generated;
     virtual void getNewUAVTraffic();
     virtual void absorbUAVTraffic();
 	// The UAVs that have reached their goals (mapping: sector -> UAVs that are "standing by")
@@ -95,6 +111,15 @@ class UTMDomainAbstract :
 	std::map<int, std::list<int> > incoming_links;
 
  protected:
+    //! Builds on airspace (taking it over) instead of a saved or new graph
+    UTMDomainAbstract(UTMModes* params, TypeGraphManager* airspace);
+    //! A copy of highGraph for a clone
+    TypeGraphManager* copyAirspace() const;
+
+    //! UAVs to plan for, and their planning: on the thread pool for A*
+    std::vector<UAV*> planning_;
+    void planPaths();
+
     // records number of UAVs at each sector at current time step
     matrix1d numUAVsAtSector;
 	matrix1d numUAVsOnLinks;
@@ -1,5 +1,6 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "UTMDomainDetail.h"
+#include <atomic>
 #include <string>
 #include <list>
 #include <vector>
@@ -10,7 +11,12 @@ using easymath::zeros;
 using std::list;
 
 UTMDomainDetail::UTMDomainDetail(UTMModes* params_set) :
-    UTMDomainAbstract(params_set){
+    UTMDomainDetail(params_set, NULL) {
+}
+
+UTMDomainDetail::UTMDomainDetail(UTMModes* params_set,
+    TypeGraphManager* airspace) :
+    UTMDomainAbstract(params_set, airspace) {
     //fix_locs(FileIn::read_pairs<XY>("agent_map/fixes.csv")) {
     // Add internal link IDs to the end of existing linkIDs
     // (important for internal travel)
@@ -40,7 +46,8 @@ UTMDomainDetail::UTMDomainDetail(UTMModes* params_set) :
     }
     for (Sector* s : sectors) {
 		delete s->generation_pt; // Delete the Fix created by the abstract constructor
-        s->generation_pt = new FixDetail(s->xy, s->ID, highGraph, lowGraph, sector_locs, params, linkIDs);
+        s->generation_pt = new FixDetail(s->xy, s->ID, highGraph, lowGraph,
+            sector_locs, params, linkIDs, &n_uavs_generated);
     }
 
 	// This is assuming there is one fix. If there's more and we need to keep track
@@ -54,6 +61,10 @@ UTMDomainDetail::UTMDomainDetail(UTMModes* params_set) :
 UTMDomainDetail::~UTMDomainDetail(void) {
 }
 
+IDomainStateful* UTMDomainDetail::clone() const {
+    return new UTMDomainDetail(params, copyAirspace());
+}
+
 
 void UTMDomainDetail::logUAVLocations() {
     matrix1d stepLocation;
@@ -229,7 +240,7 @@ void UTMDomainDetail::incrementUAVPath() {
 }
 
 void UTMDomainDetail::try_to_move(vector<UAV*> * eligible_to_move) {
-	random_shuffle(eligible_to_move->begin(), eligible_to_move->end());
+	easymath::shuffle(eligible_to_move->begin(), eligible_to_move->end());
 
 	size_t el_size;
 	do {
@@ -321,13 +332,14 @@ void UTMDomainDetail::getNewUAVTraffic() {
 }
 
 void UTMDomainDetail::reset() {
+    n_uavs_generated = 0;
     UAVs.clear();
     UAVLocations.clear();
 }
 
 
 void UTMDomainDetail::exportLog(std::string fid, double ) {
-    static int calls = 0;
+    static std::atomic<int> calls(0);
     calls++;
 }
 
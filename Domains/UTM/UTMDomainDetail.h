@@ -22,9 +22,12 @@ class UTMDomainDetail :
  public:
     explicit UTMDomainDetail(UTMModes* params_set);
     virtual ~UTMDomainDetail(void);
+    virtual IDomainStateful* clone() const;
 
     // Base function overloads
     virtual matrix1d getRewards();
+    //! No bound: the detailed rewards are not the abstract global reward
+    virtual bool rewardBound(matrix1d*) { return false; }
     virtual matrix1d getPerformance();
     virtual void getPathPlans();  // note: when is this event?
     virtual void getPathPlans(const std::list<UAV*> &new_UAVs);
@@ -53,5 +56,8 @@ class UTMDomainDetail :
     //! twice as long because there are x- and y-values
     matrix2d UAVLocations;
     void exportUAVLocations(int fileID);
+
+ protected:
+    UTMDomainDetail(UTMModes* params_set, TypeGraphManager* airspace);
 };
 #endif  // DOMAINS_UTM_UTMDOMAINDETAIL_H_
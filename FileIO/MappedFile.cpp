@@ -0,0 +1,63 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "MappedFile.h"
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(std::string file_name) : data_(NULL), bytes_(0) {
+#ifdef _WIN32
+    mapping_handle_ = NULL;
+    file_handle_ = CreateFileA(file_name.c_str(), GENERIC_READ,
+        FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_handle_ == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file_handle_, &size);
+    bytes_ = static_cast<size_t>(size.QuadPart);
+    if (bytes_ == 0) return;
+    mapping_handle_ = CreateFileMappingA(file_handle_, NULL, PAGE_READONLY,
+        0, 0, NULL);
+    if (mapping_handle_) {
+        data_ = static_cast<const char*>(MapViewOfFile(mapping_handle_,
+            FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        bytes_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(NULL, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) data_ = static_cast<const char*>(p);
+    }
+    // the mapping stays valid once the descriptor is closed
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_handle_) CloseHandle(mapping_handle_);
+    if (file_handle_ != INVALID_HANDLE_VALUE) CloseHandle(file_handle_);
+#else
+    if (data_) munmap(const_cast<char*>(data_), bytes_);
+#endif
+}
+
+void MappedFile::willNeed(size_t offset, size_t bytes) const {
+#ifndef _WIN32
+    if (!data_ || offset >= bytes_) return;
+    // madvise wants a page aligned start
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset / page * page;
+    size_t end = offset + bytes < bytes_ ? offset + bytes : bytes_;
+    madvise(const_cast<char*>(data_) + start, end - start, MADV_WILLNEED);
+#endif
+}
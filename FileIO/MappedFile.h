@@ -0,0 +1,35 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef FILEIO_MAPPEDFILE_H_
+#define FILEIO_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+* Read-only memory mapping of a whole file (mmap, or MapViewOfFile on
+* Windows). Pages are read in by the OS as they are touched, so files
+* larger than memory can be walked through without loading them.
+*/
+class MappedFile {
+ public:
+    //! Maps file_name; on failure data() is NULL
+    explicit MappedFile(std::string file_name);
+    ~MappedFile();
+
+    const char* data() const { return data_; }
+    size_t size() const { return bytes_; }
+    //! Hints that [offset, offset + bytes) will be read soon
+    void willNeed(size_t offset, size_t bytes) const;
+
+ private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const char* data_;
+    size_t bytes_;
+#ifdef _WIN32
+    void* file_handle_;
+    void* mapping_handle_;
+#endif
+};
+#endif  // FILEIO_MAPPEDFILE_H_
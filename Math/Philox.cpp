@@ -0,0 +1,145 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "Philox.h"
+#include <atomic>
+#include <cmath>
+
+namespace easymath {
+namespace {
+std::atomic<uint64_t> seed(0x853C49E6748FEA9Bull);
+std::atomic<uint64_t> streams(0);
+
+//! Ziggurat of 128 layers under the normal density, from Marsaglia and
+//! Tsang's zigset: k holds the fast-path bounds, w the scales, f the
+//! density at each layer's edge
+struct Ziggurat {
+    uint32_t k[128];
+    double w[128];
+    double f[128];
+
+    Ziggurat() {
+        const double m1 = 2147483648.0;
+        const double vn = 9.91256303526217e-3;
+        double dn = 3.442619855899;
+        double tn = dn;
+        double q = vn / exp(-0.5*dn*dn);
+        k[0] = static_cast<uint32_t>((dn / q)*m1);
+        k[1] = 0;
+        w[0] = q / m1;
+        w[127] = dn / m1;
+        f[0] = 1.0;
+        f[127] = exp(-0.5*dn*dn);
+        for (int i = 126; i >= 1; i--) {
+            dn = sqrt(-2.0*log(vn / dn + exp(-0.5*dn*dn)));
+            k[i + 1] = static_cast<uint32_t>((dn / tn)*m1);
+            tn = dn;
+            f[i] = exp(-0.5*dn*dn);
+            w[i] = dn / m1;
+        }
+    }
+};
+
+const Ziggurat &ziggurat() {
+    static const Ziggurat z;
+    return z;
+}
+}  // namespace
+
+void Philox::blocks(uint64_t first, uint32_t out[4*LANES]) const {
+    uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+    for (int b = 0; b < LANES; b++) {
+        uint64_t n = first + b;
+        c0[b] = static_cast<uint32_t>(n);
+        c1[b] = static_cast<uint32_t>(n >> 32);
+        c2[b] = stream_[0];
+        c3[b] = stream_[1];
+    }
+    uint32_t k0 = key_[0];
+    uint32_t k1 = key_[1];
+    for (int round = 0; round < 10; round++) {
+        for (int b = 0; b < LANES; b++) {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u)*c0[b];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u)*c2[b];
+            c0[b] = static_cast<uint32_t>(p1 >> 32) ^ c1[b] ^ k0;
+            c2[b] = static_cast<uint32_t>(p0 >> 32) ^ c3[b] ^ k1;
+            c1[b] = static_cast<uint32_t>(p1);
+            c3[b] = static_cast<uint32_t>(p0);
+        }
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    for (int b = 0; b < LANES; b++) {
+        out[4*b] = c0[b];
+        out[4*b + 1] = c1[b];
+        out[4*b + 2] = c2[b];
+        out[4*b + 3] = c3[b];
+    }
+}
+
+void Philox::uniforms(double* out, int n) {
+    // two words a draw, as in uniform(); whole batches skip the buffer
+    int i = 0;
+    uint32_t w[4*LANES];
+    for (; n - i >= 2*LANES; i += 2*LANES) {
+        blocks(position_, w);
+        position_ += LANES;
+        for (int k = 0; k < 2*LANES; k++) {
+            uint64_t bits = (static_cast<uint64_t>(w[2*k]) << 21)
+                ^ (w[2*k + 1] >> 11);
+            out[i + k] = (static_cast<double>(bits) + 0.5)
+                *(1.0 / 9007199254740992.0);
+        }
+    }
+    for (; i < n; i++) out[i] = uniform();
+}
+
+void Philox::normals(double* out, int n) {
+    const Ziggurat &z = ziggurat();
+    const double R = 3.442620;  // start of the tail
+    for (int i = 0; i < n; i++) {
+        int32_t h = static_cast<int32_t>(word());
+        int layer = h & 127;
+        uint32_t magnitude = h < 0 ? 0u - static_cast<uint32_t>(h) : h;
+        if (magnitude < z.k[layer]) {
+            out[i] = h*z.w[layer];
+            continue;
+        }
+        // the rest of the time: tail or wedge
+        double x;
+        while (true) {
+            x = h*z.w[layer];
+            if (layer == 0) {
+                double y;
+                do {
+                    x = -log(uniform())*(1.0 / R);
+                    y = -log(uniform());
+                } while (y + y < x*x);
+                x = (h > 0) ? R + x : -R - x;
+                break;
+            }
+            double f = z.f[layer];
+            if (f + uniform()*(z.f[layer - 1] - f) < exp(-0.5*x*x)) break;
+            h = static_cast<int32_t>(word());
+            layer = h & 127;
+            magnitude = h < 0 ? 0u - static_cast<uint32_t>(h) : h;
+            if (magnitude < z.k[layer]) {
+                x = h*z.w[layer];
+                break;
+            }
+        }
+        out[i] = x;
+    }
+}
+
+void UniqueStream::set_stream_seed(uint64_t s) {
+    seed = s;
+    streams = 0;
+}
+
+uint64_t UniqueStream::stream_seed() {
+    return seed;
+}
+
+uint64_t UniqueStream::next_stream() {
+    return streams++;
+}
+}  // namespace easymath
@@ -0,0 +1,127 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef MATH_PHILOX_H_
+#define MATH_PHILOX_H_
+
+#include <cmath>
+#include <cstdint>
+
+namespace easymath {
+/**
+* Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+* numbers: as easy as 1, 2, 3"). Each 128-bit counter value is hashed with
+* the 64-bit key into four independent 32-bit words, so a stream is just a
+* key and a position: any number of streams can run side by side without
+* sharing state, and a batch of draws is a loop of independent hashes the
+* compiler can vectorize.
+*/
+class Philox {
+ public:
+    //! blocks drawn per batch
+    static const int LANES = 16;
+
+    Philox(uint64_t seed, uint64_t stream) : position_(0), words_left_(0),
+        normals_left_(0) {
+        key_[0] = static_cast<uint32_t>(seed);
+        key_[1] = static_cast<uint32_t>(seed >> 32);
+        stream_[0] = static_cast<uint32_t>(stream);
+        stream_[1] = static_cast<uint32_t>(stream >> 32);
+    }
+
+    //! Blocks first .. first + LANES - 1 of this stream: word i of block b
+    //! goes to out[4*b + i]. Lanes are independent, so the rounds run
+    //! across all of them at once in SIMD registers.
+    void blocks(uint64_t first, uint32_t out[4*LANES]) const;
+
+    //! Next 32 random bits
+    uint32_t word() {
+        if (words_left_ == 0) {
+            blocks(position_, words_);
+            position_ += LANES;
+            words_left_ = 4*LANES;
+        }
+        return words_[4*LANES - words_left_--];
+    }
+
+    //! Uniform in (0, 1): never 0, so it is safe to take the log of
+    double uniform() {
+        // 53 random bits, offset by half a step to stay off 0 and 1
+        uint64_t hi = word();
+        uint64_t bits = (hi << 21) ^ (word() >> 11);
+        return (static_cast<double>(bits) + 0.5)*(1.0 / 9007199254740992.0);
+    }
+
+    //! n uniforms in (0, 1), straight from whole batches of blocks where
+    //! n allows; not the draws of n calls to uniform()
+    void uniforms(double* out, int n);
+
+    //! n standard normals, by the ziggurat method (Marsaglia and Tsang,
+    //! 2000): one random word each, bar the rare draws near a layer edge
+    void normals(double* out, int n);
+
+    //! One standard normal, served from batches of NORMALS
+    double normal() {
+        if (normals_left_ == 0) {
+            normals(normals_, NORMALS);
+            normals_left_ = NORMALS;
+        }
+        return normals_[NORMALS - normals_left_--];
+    }
+
+    //! Failures before the first success of trials with probability p:
+    //! the gap to the next chosen element when each is chosen with
+    //! probability p. Take log_q from skipLog(p). Capped far above any
+    //! array size.
+    uint64_t geometric(double log_q) {
+        const double CAP = 4611686018427387904.0;  // 2^62
+        if (log_q == 0.0) return 0;  // p == 1: every element
+        // 24 bits of resolution are plenty for a gap length
+        float u = (static_cast<float>(word() >> 8) + 0.5f)*(1.0f / 16777216);
+        double skip = logf(u) / log_q;
+        return static_cast<uint64_t>(skip < CAP ? skip : CAP);
+    }
+    //! log(1 - p) for geometric(), with p clamped to [0, 1]
+    static double skipLog(double p) {
+        if (p >= 1.0) return 0.0;
+        if (p <= 0.0) return -1e-300;  // every gap at the cap
+        return log1p(-p);
+    }
+
+ private:
+    static const int NORMALS = 16;
+
+    uint32_t key_[2];
+    uint32_t stream_[2];
+    //! index of the next block to draw
+    uint64_t position_;
+    uint32_t words_[4*LANES];
+    int words_left_;
+    double normals_[NORMALS];
+    int normals_left_;
+};
+
+/**
+* Philox stream that is never duplicated: a copy starts a stream of its
+* own instead of replaying the original's draws. Objects that copy
+* themselves to make offspring, like the networks in BasicNeuroEvo, can
+* hold one and still draw independently of their parents and siblings.
+* Streams are numbered in the order they are made, under the seed from
+* set_stream_seed, so single-threaded runs repeat exactly.
+*/
+class UniqueStream : public Philox {
+ public:
+    UniqueStream() : Philox(stream_seed(), next_stream()) {}
+    UniqueStream(const UniqueStream &) :
+        Philox(stream_seed(), next_stream()) {}
+    UniqueStream &operator=(const UniqueStream &) {
+        static_cast<Philox &>(*this) = Philox(stream_seed(), next_stream());
+        return *this;
+    }
+
+    static void set_stream_seed(uint64_t seed);
+    static uint64_t stream_seed();
+
+ private:
+    static uint64_t next_stream();
+};
+}  // namespace easymath
+#endif  // MATH_PHILOX_H_
@@ -0,0 +1,67 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "RandomStreams.h"
+#include <atomic>
+
+namespace easymath {
+namespace {
+std::atomic<uint64_t> run_seed(0x853C49E6748FEA9Bull);
+//! bumped by seed(), so threads remake their own streams
+std::atomic<uint64_t> seedings(0);
+std::atomic<uint64_t> threads(0);
+
+//! splitmix64's finalizer: nearby inputs to unrelated outputs
+uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27))*0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+struct ThreadStreams {
+    ThreadStreams() : number(threads++), seeding(seedings),
+        own(RandomStreams::stream(RandomStreams::THREAD, number)),
+        current(&own) {}
+    uint64_t number;
+    uint64_t seeding;
+    Philox own;
+    //! the innermost Scope's stream, or own
+    Philox* current;
+};
+thread_local ThreadStreams thread_streams;
+}  // namespace
+
+void RandomStreams::seed(uint64_t s) {
+    run_seed = s;
+    seedings++;
+    UniqueStream::set_stream_seed(s);
+}
+
+uint64_t RandomStreams::seed() {
+    return run_seed;
+}
+
+Philox RandomStreams::stream(Purpose purpose, uint64_t a, uint64_t b,
+    uint64_t c) {
+    uint64_t id = mix(mix(mix(purpose) ^ a) ^ b) ^ c;
+    return Philox(run_seed, mix(id));
+}
+
+Philox &RandomStreams::current() {
+    ThreadStreams &t = thread_streams;
+    if (t.seeding != seedings) {
+        t.seeding = seedings;
+        t.own = stream(THREAD, t.number);
+    }
+    return *t.current;
+}
+
+RandomStreams::Scope::Scope(const Philox &stream) : stream_(stream) {
+    ThreadStreams &t = thread_streams;
+    previous_ = t.current;
+    t.current = &stream_;
+}
+
+RandomStreams::Scope::~Scope() {
+    thread_streams.current = previous_;
+}
+}  // namespace easymath
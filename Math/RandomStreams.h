@@ -0,0 +1,53 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef MATH_RANDOMSTREAMS_H_
+#define MATH_RANDOMSTREAMS_H_
+
+#include <cstdint>
+#include "Philox.h"
+
+namespace easymath {
+/**
+* The library's seeded random streams. A stream is named by what it is for
+* and where it is used, stream(TRIAL, epoch, team, trial) say, and gives
+* the same draws in every run with the same seed, whichever thread asks
+* for it and in whatever order. Code that draws through easymath::rand or
+* easymath::shuffle uses the calling thread's current stream: the one a
+* Scope has set, or else the thread's own. Simulators set a stream per
+* trial, so a domain draws the same traffic on whichever replica runs it.
+*/
+class RandomStreams {
+ public:
+    //! What a stream is for; streams for different purposes never overlap
+    enum Purpose {
+        THREAD,     // the thread's own, by thread number (0: the first)
+        TRIAL,      // an epoch's evaluation: epoch, team, trial
+        CANDIDATE,  // a steady-state evaluation: candidate, trial
+        COMMON,     // a trial every team sees alike: trial
+        NPURPOSES
+    };
+
+    //! Seeds every stream, UniqueStream's included. Call before anything
+    //! draws, from the first thread.
+    static void seed(uint64_t s);
+    static uint64_t seed();
+
+    static Philox stream(Purpose purpose, uint64_t a = 0, uint64_t b = 0,
+        uint64_t c = 0);
+    //! The calling thread's current stream
+    static Philox &current();
+
+    //! Makes stream the calling thread's current one until destroyed
+    class Scope {
+     public:
+        explicit Scope(const Philox &stream);
+        ~Scope();
+
+     private:
+        Philox stream_;
+        Philox* previous_;
+        Scope(const Scope &);
+        Scope &operator=(const Scope &);
+    };
+};
+}  // namespace easymath
+#endif  // MATH_RANDOMSTREAMS_H_
@@ -35,7 +35,8 @@ std::vector<std::pair<int, int> > get_n_unique_square_subscripts(size_t n) {
 
     int n_surplus = square - n;
     for (int i = 0; i < n_surplus; i++) {
-        inds.erase(inds.begin() + std::rand() % inds.size());
+        inds.erase(inds.begin()
+            + RandomStreams::current().word() % inds.size());
     }
 
     int base = sqrt(square);
@@ -95,10 +96,17 @@ int bin(const double &n, const matrix1d& bounds) {
 }
 
 double rand(double low, double high) {
-    double r = static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
+    double r = RandomStreams::current().uniform();
     return r*(high - low) + low;
 }
 
+uint64_t hash_combine(uint64_t hash, uint64_t value) {
+    uint64_t x = (hash ^ value) + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27))*0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
 double cross(const XY &U, const XY &V) {
     return U.x*V.y - U.y*V.x;
 }
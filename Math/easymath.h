@@ -6,6 +6,7 @@
 #include <set>
 
 #include "MatrixTypes.h"
+#include "RandomStreams.h"
 #include "XY.h"
 
 namespace easymath {
@@ -33,9 +34,23 @@ typedef std::pair<XY, XY> line_segment;
 //! Coinciding endpoints excluded). Returns true if so.
 bool intersects_in_center(line_segment edge1, line_segment edge2);
 
-//! Returns a random number between some bounds.
+//! Returns a random number between some bounds, from the calling thread's
+//! current stream (see RandomStreams)
 double rand(double low, double high);
 
+//! Shuffles [first, last) with the calling thread's current stream
+template <class RandomIt>
+void shuffle(RandomIt first, RandomIt last) {
+    Philox &rng = RandomStreams::current();
+    for (long i = static_cast<long>(last - first); i > 1; i--) {
+        std::swap(first[i - 1], first[rng.word() % i]);
+    }
+}
+
+//! Folds value into hash (splitmix64's finalizer), for keys made of
+//! several parts; the order of the parts matters
+uint64_t hash_combine(uint64_t hash, uint64_t value);
+
 //! Error function (this exists in linux but not windows)
 double erfc(double x);
 
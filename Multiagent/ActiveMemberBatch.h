@@ -0,0 +1,93 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef MULTIAGENT_ACTIVEMEMBERBATCH_H_
+#define MULTIAGENT_ACTIVEMEMBERBATCH_H_
+
+#include <algorithm>
+#include <vector>
+#include "../SingleAgent/IAgent.h"
+#include "../SingleAgent/NeuroEvo/NeuroEvo.h"
+
+/**
+* The active members of a team of BasicNeuroEvo<Net> agents, stacked one
+* agent per lane of a PopulationTensor, so that a step's actions for the
+* whole team are one forward pass: a block-diagonal product, each agent's
+* state against its own weights. The members are repacked when an agent
+* moves to another member, or after invalidate() when weights may have
+* changed in place.
+*/
+template <class Net>
+class ActiveMemberBatch {
+ public:
+    typedef typename Net::scalar_type Scalar;
+
+    ActiveMemberBatch() : stale_(true) {}
+
+    //! Takes the team, and returns false if some agent is not a
+    //! BasicNeuroEvo<Net>
+    bool bind(const std::vector<IAgent*> &agents) {
+        agents_.clear();
+        for (IAgent* a : agents) {
+            BasicNeuroEvo<Net>* ne = dynamic_cast<BasicNeuroEvo<Net>*>(a);
+            if (!ne) {
+                agents_.clear();
+                return false;
+            }
+            agents_.push_back(ne);
+        }
+        stale_ = true;
+        return !agents_.empty();
+    }
+    size_t size() const { return agents_.size(); }
+    //! The members' weights may have changed without an agent moving on
+    void invalidate() { stale_ = true; }
+
+    //! Row i of S is agent i's state and row i of A gets its action, as
+    //! getAction(matrix1d) would give. Returns false, leaving A alone, if
+    //! an agent runs something other than its active member (quantized
+    //! inference), the members differ in shape, or the rows are not the
+    //! members' widths.
+    bool predict(const double* S, size_t n_inputs, double* A,
+        size_t n_outputs) {
+        size_t n = agents_.size();
+        for (size_t i = 0; i < n; i++) {
+            BasicNeuroEvo<Net>* ne = agents_[i];
+            if (ne->quantizedInference()) return false;
+            if (!stale_ && packed_[i] != *ne->pop_member_active)
+                stale_ = true;
+        }
+        if (stale_ && !pack()) return false;
+        if (n_inputs != static_cast<size_t>(tensor_.nodes().front())
+            || n_outputs != static_cast<size_t>(tensor_.nodes().back()))
+            return false;
+
+        std::copy(S, S + n*n_inputs, in_.begin());
+        tensor_.predict(in_.data(), out_.data());
+        std::copy(out_.begin(), out_.end(), A);
+        return true;
+    }
+
+ private:
+    std::vector<BasicNeuroEvo<Net>*> agents_;
+    //! the member of each agent in tensor_
+    std::vector<Net*> packed_;
+    BasicPopulationTensor<Scalar> tensor_;
+    //! states and actions in the members' precision
+    std::vector<Scalar> in_;
+    std::vector<Scalar> out_;
+    bool stale_;
+
+    //! false, leaving the batch stale, if the members differ in shape
+    bool pack() {
+        packed_.resize(agents_.size());
+        for (size_t i = 0; i < agents_.size(); i++) {
+            packed_[i] = *agents_[i]->pop_member_active;
+            if (packed_[i]->nodes() != packed_.front()->nodes()) return false;
+        }
+        tensor_.pack(packed_);
+        in_.resize(agents_.size()*tensor_.nodes().front());
+        out_.resize(agents_.size()*tensor_.nodes().back());
+        stale_ = false;
+        return true;
+    }
+};
+#endif  // MULTIAGENT_ACTIVEMEMBERBATCH_H_
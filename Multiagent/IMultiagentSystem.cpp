@@ -1,5 +1,6 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "IMultiagentSystem.h"
+#include <algorithm>
 
 IMultiagentSystem::IMultiagentSystem(void) {
 }
@@ -8,7 +9,7 @@ IMultiagentSystem::IMultiagentSystem(void) {
 IMultiagentSystem::~IMultiagentSystem(void) {
 }
 
-matrix2d IMultiagentSystem::getActions(matrix2d S) {
+matrix2d IMultiagentSystem::getActions(const matrix2d &S) {
     if (!S.size()) {
         printf("Zero state size!");
         system("pause");
@@ -21,6 +22,16 @@ matrix2d IMultiagentSystem::getActions(matrix2d S) {
     return A;
 }
 
+void IMultiagentSystem::getActions(const double* S, size_t n_inputs,
+    double* A, size_t n_outputs) {
+    for (size_t i = 0; i < agents.size(); i++) {
+        matrix1d a = agents[i]->getAction(
+            matrix1d(S + i*n_inputs, S + (i + 1)*n_inputs));
+        std::copy(a.begin(), a.begin() + std::min(a.size(), n_outputs),
+            A + i*n_outputs);
+    }
+}
+
 void IMultiagentSystem::updatePolicyValues(matrix1d R) {
     for (size_t i = 0; i < agents.size(); i++) {
         agents[i]->updatePolicyValues(R[i]);
@@ -18,7 +18,13 @@ class IMultiagentSystem {
     // Set of agents in the system (set externally)
     std::vector<IAgent*> agents;
 
-    matrix2d getActions(matrix2d S);
-    void updatePolicyValues(matrix1d R);
+    //! One action per agent, from the agent's state S[i]
+    virtual matrix2d getActions(const matrix2d &S);
+    //! Batched form: row i of S, n_inputs wide, is agent i's state, and
+    //! its action goes to row i of A, n_outputs wide. Asks each agent in
+    //! turn here; systems that can run their agents together override it.
+    virtual void getActions(const double* S, size_t n_inputs, double* A,
+        size_t n_outputs);
+    virtual void updatePolicyValues(matrix1d R);
 };
 #endif  // MULTIAGENT_IMULTIAGENTSYSTEM_H_
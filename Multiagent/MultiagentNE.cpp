@@ -1,15 +1,45 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "MultiagentNE.h"
+#include <algorithm>
 #include <vector>
+#include "../Parallel/ThreadPool.h"
 
 using std::vector;
 
-MultiagentNE::MultiagentNE(void) {}
+MultiagentNE::MultiagentNE(void) : shared_params_(NULL) {}
 
 MultiagentNE::MultiagentNE(int n_agents, NeuroEvoParameters* NE_params) :
-    NE_params(NE_params) {
+    NE_params(NE_params), shared_params_(NULL) {
     for (int i = 0; i < n_agents; i++) {
-        agents.push_back(new NeuroEvo(NE_params));
+        agents.push_back(newNeuroEvo(NE_params));
+    }
+}
+
+MultiagentNE::MultiagentNE(NeuroEvoParameters* NE_params,
+    const vector<int> &agent_groups, bool agent_id_input) :
+    NE_params(NE_params) {
+    shared_params_ = new NeuroEvoParameters(*NE_params);
+    if (agent_id_input) shared_params_->nInput++;
+
+    int n_groups = 0;
+    for (int g : agent_groups) n_groups = std::max(n_groups, g + 1);
+    group_agents_.resize(n_groups);
+    for (size_t i = 0; i < agent_groups.size(); i++) {
+        group_agents_[agent_groups[i]].push_back(i);
+    }
+    for (int g = 0; g < n_groups; g++) {
+        groups_.push_back(newNeuroEvo(shared_params_));
+    }
+
+    if (agent_id_input) agent_ids_.resize(agent_groups.size());
+    vector<size_t> place(n_groups, 0);
+    for (size_t i = 0; i < agent_groups.size(); i++) {
+        size_t g = agent_groups[i];
+        size_t n = group_agents_[g].size();
+        double id = n > 1 ? static_cast<double>(place[g]++)/(n - 1) : 0.0;
+        if (agent_id_input) agent_ids_[i] = id;
+        agents.push_back(new SharedPolicyAgent(groups_[g], agent_id_input,
+            id));
     }
 }
 
@@ -17,30 +47,37 @@ MultiagentNE::~MultiagentNE(void) {
     for (size_t i = 0; i < agents.size(); i++) {
         delete agents[i];
     }
+    for (size_t g = 0; g < groups_.size(); g++) {
+        delete groups_[g];
+    }
+    delete shared_params_;
 }
 
 void MultiagentNE::generateNewMembers() {
-    // Generate new population members
-    for (size_t i = 0; i < agents.size(); i++) {
-        reinterpret_cast<NeuroEvo*>(agents[i])->generateNewMembers();
+    // Generate new population members. One population at a time: each
+    // copy of a net takes the next UniqueStream number, so the order the
+    // copies are made in has to repeat.
+    for (size_t p = 0; p < populations(); p++) {
+        population(p)->generateNewMembers();
     }
+    actionsChanged();
 }
 
 void MultiagentNE::selectSurvivors() {
     // Specific to Evo: select survivors
-    for (size_t i = 0; i < agents.size(); i++) {
-        reinterpret_cast<NeuroEvo*>(agents[i])->selectSurvivors();
-    }
+    parallel::parallel_for(0, populations(), 1, [this](size_t p) {
+        population(p)->selectSurvivors();
+    });
+    actionsChanged();
 }
 
 bool MultiagentNE::setNextPopMembers() {
     // Kind of hacky; select the next member and return true if not at the end
     // Specific to Evo
 
-    vector<bool> is_another_member(agents.size(), false);
-    for (size_t i = 0; i < agents.size(); i++) {
-        is_another_member[i]
-            = reinterpret_cast<NeuroEvo*>(agents[i])->selectNewMember();
+    vector<bool> is_another_member(populations(), false);
+    for (size_t p = 0; p < populations(); p++) {
+        is_another_member[p] = population(p)->selectNewMember();
     }
     for (size_t i = 0; i < is_another_member.size(); i++) {
         if (!is_another_member[i]) {
@@ -49,3 +86,184 @@ bool MultiagentNE::setNextPopMembers() {
     }
     return true;
 }
+
+void MultiagentNE::updatePolicyValues(matrix1d R) {
+    if (!sharedParameters()) {
+        IMultiagentSystem::updatePolicyValues(R);
+        return;
+    }
+    matrix1d mean_R = groupMeans(R);
+    for (size_t g = 0; g < groups_.size(); g++) {
+        groups_[g]->updatePolicyValues(mean_R[g]);
+    }
+}
+
+matrix1d MultiagentNE::groupMeans(const matrix1d &R) const {
+    matrix1d mean_R(groups_.size(), 0.0);
+    for (size_t g = 0; g < groups_.size(); g++) {
+        for (size_t i : group_agents_[g]) mean_R[g] += R[i];
+        if (!group_agents_[g].empty()) mean_R[g] /= group_agents_[g].size();
+    }
+    return mean_R;
+}
+
+vector<size_t> MultiagentNE::spawnCandidates() {
+    vector<size_t> team(agents.size());
+    if (sharedParameters()) {
+        for (size_t g = 0; g < groups_.size(); g++) {
+            size_t id = groups_[g]->spawnCandidate();
+            for (size_t i : group_agents_[g]) team[i] = id;
+        }
+        return team;
+    }
+    for (size_t i = 0; i < agents.size(); i++) {
+        team[i] = static_cast<INeuroEvo*>(agents[i])->spawnCandidate();
+    }
+    return team;
+}
+
+matrix2d MultiagentNE::getCandidateActions(const vector<size_t> &team,
+    const matrix2d &S) {
+    matrix2d A(agents.size());
+    for (size_t i = 0; i < agents.size(); i++) {
+        if (sharedParameters()) {
+            SharedPolicyAgent* a = static_cast<SharedPolicyAgent*>(agents[i]);
+            A[i] = a->population()->getCandidateAction(team[i],
+                a->input(S[i]));
+        } else {
+            A[i] = static_cast<INeuroEvo*>(agents[i])->getCandidateAction(
+                team[i], S[i]);
+        }
+    }
+    return A;
+}
+
+void MultiagentNE::resolveCandidates(const vector<size_t> &team,
+    const matrix1d &R) {
+    if (sharedParameters()) {
+        matrix1d mean_R = groupMeans(R);
+        for (size_t g = 0; g < groups_.size(); g++) {
+            if (group_agents_[g].empty()) continue;
+            groups_[g]->resolveCandidate(team[group_agents_[g][0]],
+                mean_R[g]);
+        }
+    } else {
+        for (size_t i = 0; i < agents.size(); i++) {
+            static_cast<INeuroEvo*>(agents[i])->resolveCandidate(team[i],
+                R[i]);
+        }
+    }
+    actionsChanged();
+}
+
+void MultiagentNE::prepareTeams() {
+    for (size_t p = 0; p < populations(); p++) {
+        population(p)->prepareMemberActions();
+    }
+}
+
+matrix2d MultiagentNE::getTeamActions(size_t n, const matrix2d &S) {
+    matrix2d A(agents.size());
+    for (size_t i = 0; i < agents.size(); i++) {
+        if (sharedParameters()) {
+            SharedPolicyAgent* a = static_cast<SharedPolicyAgent*>(agents[i]);
+            A[i] = a->population()->getMemberAction(n, a->input(S[i]));
+        } else {
+            A[i] = static_cast<INeuroEvo*>(agents[i])->getMemberAction(n,
+                S[i]);
+        }
+    }
+    return A;
+}
+
+uint64_t MultiagentNE::teamKey(size_t n) const {
+    uint64_t key = easymath::hash_combine(0, populations());
+    for (size_t p = 0; p < populations(); p++) {
+        uint64_t member = population(p)->memberKey(n);
+        if (member == 0) return 0;
+        key = easymath::hash_combine(key, member);
+    }
+    return key;
+}
+
+bool MultiagentNE::teamOutranked(size_t n, const matrix1d &R,
+    size_t n_final) const {
+    matrix1d population_R = sharedParameters() ? groupMeans(R) : R;
+    for (size_t p = 0; p < populations(); p++) {
+        if (!population(p)->outranked(n, population_R[p], n_final))
+            return false;
+    }
+    return true;
+}
+
+matrix2d MultiagentNE::getActions(const matrix2d &S) {
+    if (!S.size()) {
+        printf("Zero state size!");
+        system("pause");
+    }
+    if (S.size() < agents.size()) {
+        printf("MultiagentNE: fewer states than agents.");
+        system("pause");
+        exit(1);
+    }
+    size_t n_in = NE_params->nInput;
+    size_t n_out = NE_params->nOutput;
+    states_.resize(agents.size()*n_in);
+    actions_.resize(agents.size()*n_out);
+    for (size_t i = 0; i < agents.size(); i++) {
+        NeuralNet::cmp_int_fatal(S[i].size(), n_in);
+        std::copy(S[i].begin(), S[i].begin() + n_in,
+            states_.begin() + i*n_in);
+    }
+    getActions(states_.data(), n_in, actions_.data(), n_out);
+    return unpackActions();
+}
+
+matrix2d MultiagentNE::unpackActions() const {
+    size_t n_out = NE_params->nOutput;
+    matrix2d A(agents.size());
+    for (size_t i = 0; i < agents.size(); i++) {
+        A[i].assign(actions_.begin() + i*n_out,
+            actions_.begin() + (i + 1)*n_out);
+    }
+    return A;
+}
+
+void MultiagentNE::getActions(const double* S, size_t n_inputs, double* A,
+    size_t n_outputs) {
+    if (sharedParameters()) {
+        for (size_t g = 0; g < groups_.size(); g++) {
+            if (groupActions(g, S, n_inputs, A, n_outputs)) continue;
+            for (size_t i : group_agents_[g]) {
+                matrix1d a = agents[i]->getAction(
+                    matrix1d(S + i*n_inputs, S + (i + 1)*n_inputs));
+                std::copy(a.begin(),
+                    a.begin() + std::min(a.size(), n_outputs),
+                    A + i*n_outputs);
+            }
+        }
+        return;
+    }
+    if (batched_agents_ != agents) {
+        batched_agents_ = agents;
+        bool doubles = batch_.bind(agents);
+        float_batch_.bind(doubles ? vector<IAgent*>() : agents);
+    }
+    if (batch_.size() && batch_.predict(S, n_inputs, A, n_outputs)) return;
+    if (float_batch_.size()
+        && float_batch_.predict(S, n_inputs, A, n_outputs)) return;
+    IMultiagentSystem::getActions(S, n_inputs, A, n_outputs);
+}
+
+bool MultiagentNE::groupActions(size_t g, const double* S, size_t n_inputs,
+    double* A, size_t n_outputs) {
+    if (group_agents_[g].empty()) return true;
+    // the groups are made by newNeuroEvo, in shared_params_' precision
+    if (shared_params_->precision == NeuroEvoParameters::FLOAT) {
+        return float_shared_batch_.predict(
+            static_cast<FloatNeuroEvo*>(groups_[g]), group_agents_[g],
+            agent_ids_, S, n_inputs, A, n_outputs);
+    }
+    return shared_batch_.predict(static_cast<NeuroEvo*>(groups_[g]),
+        group_agents_[g], agent_ids_, S, n_inputs, A, n_outputs);
+}
@@ -2,7 +2,10 @@
 #ifndef MULTIAGENT_MULTIAGENTNE_H_
 #define MULTIAGENT_MULTIAGENTNE_H_
 
+#include <vector>
 #include "IMultiagentSystem.h"
+#include "ActiveMemberBatch.h"
+#include "SharedPolicy.h"
 #include "../SingleAgent/NeuroEvo/NeuroEvo.h"
 
 class MultiagentNE :
@@ -10,11 +13,101 @@ class MultiagentNE :
  public:
     MultiagentNE(void);
     MultiagentNE(int n_agents, NeuroEvoParameters* NE_params);
+    //! Shared-parameter mode: agents with the same entry in agent_groups
+    //! (all of them, or each type, say) share one population, so memory
+    //! and mutation cost grow with the groups rather than the agents. A
+    //! group's agents act in one batched pass, and its member's fitness
+    //! is their mean reward. With agent_id_input the networks take one
+    //! more input, the agent's place in its group scaled to [0, 1], so
+    //! that a shared member can still act differently per agent.
+    MultiagentNE(NeuroEvoParameters* NE_params,
+        const std::vector<int> &agent_groups, bool agent_id_input = false);
     ~MultiagentNE(void);
+    bool sharedParameters() const { return !groups_.empty(); }
     void generateNewMembers();
     virtual void selectSurvivors();
     virtual bool setNextPopMembers();
 
+    //! When every agent is a NeuroEvo (or every one a FloatNeuroEvo)
+    //! running its members directly, the agents' active members run as
+    //! one ActiveMemberBatch pass; otherwise each agent is asked in turn.
+    //! Call actionsChanged() after changing member weights other than
+    //! through this class.
+    matrix2d getActions(const matrix2d &S);
+    void getActions(const double* S, size_t n_inputs, double* A,
+        size_t n_outputs);
+    void actionsChanged() {
+        batch_.invalidate();
+        float_batch_.invalidate();
+    }
+    //! In shared-parameter mode a member is rewarded with the mean of R
+    //! over its group's agents
+    void updatePolicyValues(matrix1d R);
+
+    //! Steady-state evolution (see INeuroEvo): a team is one candidate per
+    //! agent, by agent (the group's candidate, in shared-parameter mode)
+    std::vector<size_t> spawnCandidates();
+    //! Safe to call from several threads, one per team
+    matrix2d getCandidateActions(const std::vector<size_t> &team,
+        const matrix2d &S);
+    void resolveCandidates(const std::vector<size_t> &team,
+        const matrix1d &R);
+
+    //! Generational evaluation on several threads: team n of an epoch is
+    //! member n of every population, the team setNextPopMembers reaches
+    //! after n calls. After prepareTeams, getTeamActions is safe to call
+    //! from several threads, one per team, until the populations change.
+    size_t nTeams() const { return population(0)->nMembers(); }
+    void prepareTeams();
+    matrix2d getTeamActions(size_t n, const matrix2d &S);
+    //! Identifies team n by its members' keys (INeuroEvo::memberKey), in
+    //! population order; 0 if one of them has no key
+    uint64_t teamKey(size_t n) const;
+    //! Racing: whether team n, each agent rewarded no more than R, is sure
+    //! to be dropped from every population once teams 0 .. n_final - 1
+    //! have been rewarded this epoch (see INeuroEvo::outranked)
+    bool teamOutranked(size_t n, const matrix1d &R, size_t n_final) const;
+
     NeuroEvoParameters* NE_params;
+
+ protected:
+    //! contiguous states and actions, [agent][element], for the batched
+    //! getActions
+    matrix1d states_;
+    matrix1d actions_;
+    //! actions_ as one row per agent
+    matrix2d unpackActions() const;
+
+ private:
+    //! agents as batch_ or float_batch_ was last bound to them
+    std::vector<IAgent*> batched_agents_;
+    ActiveMemberBatch<NeuralNet> batch_;
+    ActiveMemberBatch<FloatNeuralNet> float_batch_;
+
+    //! Shared-parameter mode: the group populations, which the agents
+    //! (SharedPolicyAgents) act through, and the agents of each group
+    std::vector<INeuroEvo*> groups_;
+    std::vector<std::vector<size_t> > group_agents_;
+    //! NE_params plus the id input, if any
+    NeuroEvoParameters* shared_params_;
+    //! each agent's id input; empty without them
+    matrix1d agent_ids_;
+    SharedPolicyBatch<NeuralNet> shared_batch_;
+    SharedPolicyBatch<FloatNeuralNet> float_shared_batch_;
+
+    //! what evolves: the groups if shared, otherwise the agents
+    size_t populations() const {
+        return sharedParameters() ? groups_.size() : agents.size();
+    }
+    INeuroEvo* population(size_t p) const {
+        return sharedParameters() ? groups_[p]
+            : static_cast<INeuroEvo*>(agents[p]);
+    }
+    //! R averaged over each group's agents
+    matrix1d groupMeans(const matrix1d &R) const;
+    //! the batched getActions for group g; false if it has to go agent
+    //! by agent
+    bool groupActions(size_t g, const double* S, size_t n_inputs,
+        double* A, size_t n_outputs);
 };
 #endif  // MULTIAGENT_MULTIAGENTNE_H_
@@ -38,7 +38,28 @@ MultiagentTypeNE::MultiagentTypeNE(int n_agents, NeuroEvoParameters* NE_params,
 MultiagentTypeNE::~MultiagentTypeNE(void) {
 }
 
-matrix2d MultiagentTypeNE::getActions(matrix3d state) {
+matrix2d MultiagentTypeNE::getActions(const matrix3d &state) {
+    if (type_mode == BLIND) {
+        size_t n_in = NE_params->nInput;
+        size_t n_out = NE_params->nOutput;
+        if (state.size() < agents.size()) {
+            printf("MultiagentTypeNE: fewer states than agents.");
+            system("pause");
+            exit(1);
+        }
+        states_.assign(agents.size()*n_in, 0.0);
+        actions_.resize(agents.size()*n_out);
+        for (size_t i = 0; i < agents.size(); i++) {
+            double* s = &states_[i*n_in];
+            for (const matrix1d &type_state : state[i]) {
+                NeuralNet::cmp_int_fatal(type_state.size(), n_in);
+                for (size_t j = 0; j < n_in; j++) s[j] += type_state[j];
+            }
+        }
+        getActions(states_.data(), n_in, actions_.data(), n_out);
+        return unpackActions();
+    }
+
     matrix2d actions(state.size());  // get an action vector for each agent
     for (size_t i = 0; i < agents.size(); i++) {
         actions[i] = agents[i]->getAction(state[i]);
@@ -26,7 +26,11 @@ class MultiagentTypeNE : public MultiagentNE {
 
     // void initializeWithStereotypes(std::vector<std::vector<NeuroEvo*> >
     // stereotypes, std::vector<int> agent_types);
-    matrix2d getActions(matrix3d state);
+    using MultiagentNE::getActions;
+    //! state[agent][type][element]. In BLIND mode the types are summed
+    //! into one state per agent and the team runs batched, as in
+    //! MultiagentNE::getActions.
+    matrix2d getActions(const matrix3d &state);
 
     //! Returns true if multiple neural nets are used
     //! Currently only done in the multimind case
@@ -43,7 +47,7 @@ class MultiagentTypeNE : public MultiagentNE {
                 not_end[i] = reinterpret_cast<TypeNeuroEvo*>
                     (agents[i])->selectNewMemberAll();
             } else {
-                not_end[i] = reinterpret_cast<NeuroEvo*>
+                not_end[i] = static_cast<INeuroEvo*>
                     (agents[i])->selectNewMember();
             }
         }
@@ -73,7 +77,7 @@ class MultiagentTypeNE : public MultiagentNE {
             } else if (type_mode == WEIGHTED ||
                 type_mode == CROSSWEIGHTED ||
                 type_mode == BLIND) {
-                reinterpret_cast<NeuroEvo*>(a)->selectSurvivors();
+                static_cast<INeuroEvo*>(a)->selectSurvivors();
             }
         }
     }
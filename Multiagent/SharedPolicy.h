@@ -0,0 +1,100 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef MULTIAGENT_SHAREDPOLICY_H_
+#define MULTIAGENT_SHAREDPOLICY_H_
+
+#include <algorithm>
+#include <vector>
+#include "../SingleAgent/IAgent.h"
+#include "../SingleAgent/NeuroEvo/NeuroEvo.h"
+
+/**
+* An agent of a shared-parameter team (see MultiagentNE): it acts with the
+* active member of a population it shares with the rest of its group, and
+* optionally tells the network which agent it is through one extra input.
+* Evolution and rewards go through the MultiagentNE, once per group.
+*/
+class SharedPolicyAgent : public IAgent {
+ public:
+    SharedPolicyAgent(INeuroEvo* population, bool id_input, double id) :
+        population_(population), id_input_(id_input), id_(id) {}
+
+    INeuroEvo* population() const { return population_; }
+    //! state as the shared network takes it
+    matrix1d input(const matrix1d &state) const {
+        if (!id_input_) return state;
+        matrix1d in(state);
+        in.push_back(id_);
+        return in;
+    }
+
+    matrix1d getAction(matrix1d state) {
+        return population_->getAction(input(state));
+    }
+    matrix1d getAction(matrix2d state) {
+        matrix1d stateSum(state[0].size(), 0.0);
+        for (size_t i = 0; i < state.size(); i++) {
+            for (size_t j = 0; j < state[i].size(); j++) {
+                stateSum[j] += state[i][j];
+            }
+        }
+        return getAction(stateSum);
+    }
+    //! Rewards the member the group is running with this agent's R alone.
+    //! MultiagentNE rewards it once with the mean over the group instead.
+    void updatePolicyValues(double R) {
+        population_->updatePolicyValues(R);
+    }
+
+ private:
+    INeuroEvo* population_;
+    bool id_input_;
+    double id_;
+};
+
+/**
+* Actions for a group of agents sharing one BasicNeuroEvo<Net>: the active
+* member runs once over all of the group's states, one row per agent,
+* using batchPredictContinuous.
+*/
+template <class Net>
+class SharedPolicyBatch {
+ public:
+    typedef typename Net::scalar_type Scalar;
+
+    //! Rows members[k] of S (n_inputs wide) to the same rows of A
+    //! (n_outputs wide). ids, if not empty, holds each agent's id input.
+    //! Returns false, leaving A alone, if the population runs something
+    //! other than its active member (quantized inference) or the widths
+    //! do not match its networks.
+    bool predict(BasicNeuroEvo<Net>* ne, const std::vector<size_t> &members,
+        const matrix1d &ids, const double* S, size_t n_inputs, double* A,
+        size_t n_outputs) {
+        if (ne->quantizedInference()) return false;
+        Net* net = *ne->pop_member_active;
+        size_t width = n_inputs + (ids.empty() ? 0 : 1);
+        if (width != static_cast<size_t>(net->nodes().front())
+            || n_outputs != static_cast<size_t>(net->nodes().back()))
+            return false;
+
+        size_t n = members.size();
+        in_.resize(n*width);
+        out_.resize(n*n_outputs);
+        for (size_t k = 0; k < n; k++) {
+            const double* s = S + members[k]*n_inputs;
+            std::copy(s, s + n_inputs, in_.begin() + k*width);
+            if (!ids.empty()) in_[k*width + n_inputs] = ids[members[k]];
+        }
+        net->batchPredictContinuous(in_.data(), static_cast<int>(n),
+            out_.data());
+        for (size_t k = 0; k < n; k++) {
+            std::copy(out_.begin() + k*n_outputs,
+                out_.begin() + (k + 1)*n_outputs, A + members[k]*n_outputs);
+        }
+        return true;
+    }
+
+ private:
+    std::vector<Scalar> in_;
+    std::vector<Scalar> out_;
+};
+#endif  // MULTIAGENT_SHAREDPOLICY_H_
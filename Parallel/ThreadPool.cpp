@@ -0,0 +1,142 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "ThreadPool.h"
+#include <utility>
+#include <vector>
+
+namespace parallel {
+namespace {
+//! the pool and queue of the worker running on this thread, if any
+thread_local ThreadPool* worker_pool = NULL;
+thread_local size_t worker_index = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(size_t n_threads) : signals_(0), stop_(false) {
+    start(n_threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1
+        ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+void ThreadPool::resize(size_t n_threads) {
+    stop();
+    start(n_threads);
+}
+
+void ThreadPool::start(size_t n_threads) {
+    stop_ = false;
+    for (size_t i = 0; i < n_threads; i++) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (size_t i = 0; i < n_threads; i++) {
+        workers_.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &t : workers_) t.join();
+    workers_.clear();
+    queues_.clear();
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    worker_pool = this;
+    worker_index = index;
+    while (true) {
+        size_t seen = signals();
+        if (runOne()) continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [&] { return stop_ || signals_ != seen; });
+        if (stop_) return;
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    Queue* q = worker_pool == this ? queues_[worker_index].get()
+        : &injected_;
+    {
+        std::lock_guard<std::mutex> lock(q->mutex);
+        q->tasks.push_back(std::move(task));
+    }
+    signal();
+}
+
+bool ThreadPool::runOne(TaskGroup* group) {
+    Task task;
+    bool mine = worker_pool == this;
+    bool found = mine
+        && pop(queues_[worker_index].get(), true, group, &task);
+    if (!found) found = pop(&injected_, false, group, &task);
+    // steal, starting from the next worker along
+    size_t first = mine ? worker_index + 1 : 0;
+    for (size_t k = 0; !found && k < queues_.size(); k++) {
+        found = pop(queues_[(first + k) % queues_.size()].get(), false,
+            group, &task);
+    }
+    if (!found) return false;
+
+    task.run();
+    if (--task.group->pending_ == 0) signal();
+    return true;
+}
+
+bool ThreadPool::pop(Queue* q, bool newest, TaskGroup* group,
+    Task* task) {
+    std::lock_guard<std::mutex> lock(q->mutex);
+    size_t n = q->tasks.size();
+    for (size_t k = 0; k < n; k++) {
+        size_t i = newest ? n - 1 - k : k;
+        if (group && q->tasks[i].group != group) continue;
+        *task = std::move(q->tasks[i]);
+        q->tasks.erase(q->tasks.begin() + i);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::signal() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        signals_++;
+    }
+    wake_.notify_all();
+}
+
+void ThreadPool::sleep(size_t seen, const std::function<bool()> &done) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [&] { return signals_ != seen || done(); });
+}
+
+size_t ThreadPool::signals() {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    return signals_;
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    if (pool_->workers_.empty()) {
+        task();
+        return;
+    }
+    pending_++;
+    pool_->submit(ThreadPool::Task{std::move(task), this});
+}
+
+void TaskGroup::wait() {
+    while (pending_ != 0) {
+        size_t seen = pool_->signals();
+        if (pool_->runOne(this)) continue;
+        pool_->sleep(seen, [this] { return pending_ == 0; });
+    }
+}
+}  // namespace parallel
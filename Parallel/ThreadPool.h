@@ -0,0 +1,137 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef PARALLEL_THREADPOOL_H_
+#define PARALLEL_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* The library's one set of worker threads. Each worker keeps a deque of
+* tasks: it runs its own newest task first, and when it has none it
+* steals the oldest task of another worker. A thread waiting on a
+* TaskGroup runs that group's queued tasks meanwhile instead of blocking,
+* so parallel regions nest (evaluation over teams, planning inside each
+* domain) without ever running more threads than the pool has. It runs
+* only that group's: a wait that took up an unrelated task, such as a
+* whole team's evaluation, could not return until that task did.
+*/
+namespace parallel {
+class TaskGroup;
+
+class ThreadPool {
+ public:
+    //! n_threads workers, besides the threads that wait on task groups;
+    //! with none, tasks run on the thread that adds them
+    explicit ThreadPool(size_t n_threads);
+    ~ThreadPool();
+
+    //! The pool the library shares: one thread per core, counting the
+    //! caller's
+    static ThreadPool& shared();
+    //! Restarts the workers as n_threads; only while no task is queued
+    void resize(size_t n_threads);
+    //! threads that can run tasks at once, waiting callers included
+    size_t concurrency() const { return workers_.size() + 1; }
+
+ private:
+    friend class TaskGroup;
+    struct Task {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+    //! a worker's tasks, newest at the back
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue> > queues_;
+    //! tasks added by threads outside the pool
+    Queue injected_;
+    //! sleeping threads wait here for signals_ to change
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    size_t signals_;
+    bool stop_;
+
+    void start(size_t n_threads);
+    void stop();
+    void workerLoop(size_t index);
+    void submit(Task task);
+    //! Runs one queued task, the caller's own first; false if none. With
+    //! a group, only a task of that group.
+    bool runOne(TaskGroup* group = NULL);
+    //! takes the newest or oldest task in q, of group if one is given
+    bool pop(Queue* q, bool newest, TaskGroup* group, Task* task);
+    //! Wakes every sleeping thread to look again
+    void signal();
+    //! Sleeps until signal() or done(), unless a task was queued since
+    //! seen was read from signals_
+    void sleep(size_t seen, const std::function<bool()> &done);
+    size_t signals();
+};
+
+/**
+* Tasks that are waited for together. wait() returns once every task run
+* through the group is done, running the group's queued tasks itself
+* meanwhile.
+*/
+class TaskGroup {
+ public:
+    explicit TaskGroup(ThreadPool* pool = &ThreadPool::shared()) :
+        pool_(pool), pending_(0) {}
+    ~TaskGroup() { wait(); }
+
+    void run(std::function<void()> task);
+    void wait();
+
+ private:
+    friend class ThreadPool;
+    ThreadPool* pool_;
+    std::atomic<size_t> pending_;
+};
+
+//! f(i) for every i in [begin, end), grain indices to a task
+template <class F>
+void parallel_for(size_t begin, size_t end, size_t grain, F f,
+    ThreadPool* pool = &ThreadPool::shared()) {
+    if (grain == 0) grain = 1;
+    TaskGroup group(pool);
+    for (size_t lo = begin; lo < end; lo += grain) {
+        size_t hi = lo + grain < end ? lo + grain : end;
+        group.run([lo, hi, &f] {
+            for (size_t i = lo; i < hi; i++) f(i);
+        });
+    }
+    group.wait();
+}
+
+//! combine over map(i) for i in [begin, end), starting from identity.
+//! The chunks are fixed by grain, and their partial results combined in
+//! order, so floating-point results repeat whatever the thread count.
+template <class T, class Map, class Combine>
+T parallel_reduce(size_t begin, size_t end, size_t grain, T identity,
+    Map map, Combine combine, ThreadPool* pool = &ThreadPool::shared()) {
+    if (grain == 0) grain = 1;
+    size_t n_chunks = end > begin ? (end - begin + grain - 1)/grain : 0;
+    std::vector<T> partial(n_chunks, identity);
+    parallel_for(0, n_chunks, 1, [&](size_t c) {
+        size_t lo = begin + c*grain;
+        size_t hi = lo + grain < end ? lo + grain : end;
+        for (size_t i = lo; i < hi; i++) {
+            partial[c] = combine(partial[c], map(i));
+        }
+    }, pool);
+    T result = identity;
+    for (const T &p : partial) result = combine(result, p);
+    return result;
+}
+}  // namespace parallel
+#endif  // PARALLEL_THREADPOOL_H_
@@ -22,6 +22,9 @@ TypeGraphManager::TypeGraphManager(void) {
 TypeGraphManager::TypeGraphManager(int n_types, vector<edge> edges,
     vector<XY> locs) :
     n_types(n_types), edges(edges), rags_map(new RAGS(locs, edges)) {
+    for (size_t i = 0; i < locs.size(); i++) {
+        loc2mem[locs[i]] = i;  // add in reverse lookup
+    }
     initializeTypeLookupAndDirections(locs);
 }
 
@@ -61,7 +64,7 @@ TypeGraphManager::TypeGraphManager(int n_vertices, int n_types,
     vector<edge > candidates(candidates_set.size());
     copy(candidates_set.begin(), candidates_set.end(), candidates.begin());
 
-    random_shuffle(candidates.begin(), candidates.end());
+    easymath::shuffle(candidates.begin(), candidates.end());
 
     // Add as many edges as possible
     for (edge c : candidates) {
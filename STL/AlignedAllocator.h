@@ -0,0 +1,80 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef STL_ALIGNEDALLOCATOR_H_
+#define STL_ALIGNEDALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace easystl {
+//! Default alignment: one cache line, which also covers AVX-512 loads
+static const size_t CACHE_LINE = 64;
+
+//! Allocator handing out memory aligned to Alignment bytes
+template <class T, size_t Alignment = CACHE_LINE>
+class aligned_allocator {
+ public:
+    typedef T value_type;
+    template <class U> struct rebind {
+        typedef aligned_allocator<U, Alignment> other;
+    };
+
+    aligned_allocator() {}
+    template <class U>
+    aligned_allocator(const aligned_allocator<U, Alignment> &) {}
+
+    T* allocate(size_t n) {
+        if (n == 0) return NULL;
+        // round up so that aligned_alloc's size requirement is satisfied
+        size_t bytes = ((n*sizeof(T) + Alignment - 1) / Alignment)*Alignment;
+#ifdef _WIN32
+        void* p = _aligned_malloc(bytes, Alignment);
+#else
+        void* p = NULL;
+        if (posix_memalign(&p, Alignment, bytes) != 0) p = NULL;
+#endif
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    template <class U>
+    bool operator==(const aligned_allocator<U, Alignment> &) const {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const aligned_allocator<U, Alignment> &) const {
+        return false;
+    }
+};
+
+//! Number of T elements that make up Alignment bytes
+template <class T, size_t Alignment = CACHE_LINE>
+size_t aligned_stride() {
+    return Alignment / sizeof(T);
+}
+
+//! Rounds n elements up so the following block starts on an aligned boundary
+template <class T, size_t Alignment = CACHE_LINE>
+size_t round_up_aligned(size_t n) {
+    size_t stride = aligned_stride<T, Alignment>();
+    return ((n + stride - 1) / stride)*stride;
+}
+
+//! std::vector whose buffer starts on a cache line boundary
+template <class T>
+using aligned_vector = std::vector<T, aligned_allocator<T> >;
+}  // namespace easystl
+#endif  // STL_ALIGNEDALLOCATOR_H_
@@ -2,19 +2,113 @@
 #include "SimNE.h"
 
 #include "float.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../Parallel/ThreadPool.h"
+
+using std::vector;
+using easymath::RandomStreams;
+
+namespace {
+//! A candidate team out for evaluation in runSteadyState
+struct Evaluation {
+    int seq;  // order the team was made in
+    vector<size_t> team;
+    matrix1d R;
+    double perf;
+    bool done;
+};
+}  // namespace
 
 SimNE::SimNE(IDomainStateful* domain, MultiagentNE* MAS) :
-    ISimulator(domain, MAS), step(new int(0)) {
+    ISimulator(domain, MAS), step(new int(0)),
+    racing_(false), trial_z_(0.0), teams_stopped_(0), steps_skipped_(0),
+    cache_on_(false), reevaluate_stochastic_(true), cache_lookups_(0),
+    cache_hits_(0) {
     domain->synch_step(step);
 }
 
 SimNE::~SimNE(void) {
+    for (IDomainStateful* d : replicas_) delete d;
     delete step;
 }
 
+bool SimNE::setWorkers(size_t n_workers) {
+    for (IDomainStateful* d : replicas_) delete d;
+    replicas_.clear();
+    for (size_t w = 0; w < n_workers; w++) {
+        IDomainStateful* d = domain->clone();
+        if (!d) {
+            for (IDomainStateful* r : replicas_) delete r;
+            replicas_.clear();
+            return false;
+        }
+        replicas_.push_back(d);
+    }
+    // sized once: the replicas keep pointers into it
+    replica_steps_.assign(replicas_.size(), 0);
+    for (size_t w = 0; w < replicas_.size(); w++) {
+        replicas_[w]->synch_step(&replica_steps_[w]);
+    }
+    return true;
+}
+
+void SimNE::setFitnessCache(bool on, bool reevaluate_stochastic) {
+    cache_on_ = on;
+    reevaluate_stochastic_ = reevaluate_stochastic;
+    fitness_cache_.clear();
+    cache_lookups_ = 0;
+    cache_hits_ = 0;
+}
+
+void SimNE::setRacing(bool on, double trial_z) {
+    racing_ = on;
+    trial_z_ = trial_z;
+    teams_stopped_ = 0;
+    steps_skipped_ = 0;
+}
+
+bool SimNE::fitnessCacheActive() const {
+    return cache_on_ && !(reevaluate_stochastic_ && domain->stochastic());
+}
+
+double SimNE::cacheHitRate() const {
+    if (cache_lookups_ == 0) return 0.0;
+    return static_cast<double>(cache_hits_) / cache_lookups_;
+}
+
+vector<uint64_t> SimNE::teamKeys() {
+    MultiagentNE* mas = reinterpret_cast<MultiagentNE*>(MAS);
+    uint64_t context = easymath::hash_combine(domain->configurationKey(),
+        RandomStreams::seed());
+    context = easymath::hash_combine(context, domain->n_steps);
+    context = easymath::hash_combine(context, n_trials);
+    vector<uint64_t> keys(mas->nTeams());
+    for (size_t n = 0; n < keys.size(); n++) {
+        uint64_t team = mas->teamKey(n);
+        if (team != 0) keys[n] = easymath::hash_combine(context, team);
+    }
+    return keys;
+}
+
+easymath::Philox SimNE::trialStream(int ep, size_t n, int t) const {
+    if (fitnessCacheActive())
+        return RandomStreams::stream(RandomStreams::COMMON, t);
+    return RandomStreams::stream(RandomStreams::TRIAL, ep, n, t);
+}
+
 void SimNE::runExperiment() {
     for (int ep = 0; ep < n_epochs; ep++) {
         time_t epoch_start = time(NULL);
+        size_t lookups = cache_lookups_, hits = cache_hits_;
+        size_t stopped = teams_stopped_, skipped = steps_skipped_;
         this->epoch(ep);
         time_t epoch_end = time(NULL);
         time_t epoch_time = epoch_end - epoch_start;
@@ -27,6 +121,19 @@ void SimNE::runExperiment() {
 #endif
 
          printf("Epoch %i took %i seconds.\n",ep,size_t(epoch_time));
+        if (fitnessCacheActive()) {
+            printf("Fitness cache: %i of %i teams reused (run: %.1f%%).\n",
+                static_cast<int>(cache_hits_ - hits),
+                static_cast<int>(cache_lookups_ - lookups),
+                100.0*cacheHitRate());
+        }
+        if (racing_) {
+            printf("Racing: %i teams stopped, %i steps skipped (run: %i, "
+                "%i).\n", static_cast<int>(teams_stopped_ - stopped),
+                static_cast<int>(steps_skipped_ - skipped),
+                static_cast<int>(teams_stopped_),
+                static_cast<int>(steps_skipped_));
+        }
          std::cout << "Estimated run end time: " << end_clock_time << std::endl;
     }
 }
@@ -34,65 +141,97 @@ void SimNE::runExperiment() {
 void SimNE::epoch(int ep) {
     bool log = (ep == 0 || ep == n_epochs - 1) ? true : false;
 
-    reinterpret_cast<MultiagentNE*>(MAS)->generateNewMembers();
+    MultiagentNE* mas = reinterpret_cast<MultiagentNE*>(MAS);
+    mas->generateNewMembers();
     double best_run = -DBL_MAX;
     double best_run_performance = -DBL_MAX;
 
-    int n = 0;  // neural net number (for output file name)
+    size_t n = 0;  // neural net number (for output file name)
 
     int best_perf_idx = 0;  // the team that performed the best
 
+    // teams in the cache are looked up rather than simulated, but epochs
+    // that log simulate them all (and still fill the cache)
+    vector<uint64_t> keys;
+    if (fitnessCacheActive()) keys = teamKeys();
+
+    // teams from n_final on are raced against the survivors before them
+    const size_t all = std::numeric_limits<size_t>::max();
+    size_t n_final = all;
+    if (racing_ && !log) n_final = NeuroEvoParameters::popSize;
+
+    // with workers, teams are scored up front: the survivors, then the
+    // teams raced against them once the survivors are rewarded. The loop
+    // applies the results in the same order as it would its own.
+    bool parallel = !log && !replicas_.empty();
+    vector<TeamScore> scores;
+
     do {
-        matrix2d Rtrials;   // Trial average reward
-        for (int t = 0; t < n_trials; t++) {
-            clock_t tref = clock();
-            for ((*step) = 0; (*step) < domain->n_steps; (*step)++) {
-                // must be called by 'this' in order to access potential child
-                // class overload
-                matrix2d A = this->getActions();
-                domain->simulateStep(A);
+        if (parallel && (n == 0 || n == n_final)) {
+            evaluateTeams(ep, keys, n, n == 0 ? n_final : all, n_final,
+                &scores);
+        }
 
-                if (log)
-                    // Log positions of UAVs
-                    domain->logStep();
+        CachedFitness* cached = NULL;
+        if (!log && !keys.empty() && keys[n] != 0) {
+            cache_lookups_++;
+            std::map<uint64_t, CachedFitness>::iterator it
+                = fitness_cache_.find(keys[n]);
+            if (it != fitness_cache_.end()) {
+                cache_hits_++;
+                cached = &it->second;
+                cached->epoch = ep;
             }
-            // t= clock();
-            // printf("t=%f\n",float(t-tref)/CLOCKS_PER_SEC);
-            // tref=t;
-
-            matrix1d R = domain->getRewards();
-            matrix1d perf = domain->getPerformance();
+        }
+        TeamScore scored;
+        const TeamScore* score = &scored;
+        if (cached) {
+            score = &cached->score;
+        } else if (parallel) {
+            score = &scores[n];
+        } else {
+            scored = scoreTeam(ep, n, domain, step, log, n_final);
+        }
+        if (!cached && !score->stopped && !keys.empty() && keys[n] != 0) {
+            CachedFitness &entry = fitness_cache_[keys[n]];
+            entry.score = *score;
+            entry.epoch = ep;
+        }
 
-            double avg_G = easymath::mean(R);
-            double avg_perf = easymath::mean(perf);
+        if (score->stopped) {
+            teams_stopped_++;
+            steps_skipped_ += score->skipped;
+            printf("NN#%i, stopped early\n", static_cast<int>(n));
+        }
+        for (size_t t = 0; t < score->perf.size(); t++) {
+            double avg_G = easymath::mean(score->R[t]);
+            double avg_perf = score->perf[t];
 
             if (avg_G > best_run) {
                 best_run = avg_G;
             }
             if (avg_perf > best_run_performance) {
                 best_run_performance = avg_perf;
-                best_perf_idx = n;
+                best_perf_idx = static_cast<int>(n);
             }
 
-            printf("NN#%i, %f, %f, %f\n", n, best_run_performance,
-                best_run, avg_perf);
-
-            std::ostringstream epi, ni, ti;
-            epi << ep;
-            ni << n;
-            ti << t;
-
-            Rtrials.push_back(R);
-
-
-            domain->reset();
+            printf("NN#%i, %f, %f, %f\n", static_cast<int>(n),
+                best_run_performance, best_run, avg_perf);
         }
         // based on the trials...
-        MAS->updatePolicyValues(easymath::mean2(Rtrials));
+        MAS->updatePolicyValues(easymath::mean2(score->R));
 
         n++;
-    } while (reinterpret_cast<MultiagentNE*>(MAS)->setNextPopMembers());
-    reinterpret_cast<MultiagentNE*>(MAS)->selectSurvivors();
+    } while (mas->setNextPopMembers());
+    mas->selectSurvivors();
+    // keep the teams this epoch scored: the next one re-pairs survivors
+    std::map<uint64_t, CachedFitness>::iterator it = fitness_cache_.begin();
+    while (it != fitness_cache_.end()) {
+        if (it->second.epoch == ep)
+            ++it;
+        else
+            it = fitness_cache_.erase(it);
+    }
 
     reward_log.push_back(best_run);
     metric_log.push_back(best_run_performance);
@@ -102,7 +241,253 @@ void SimNE::epoch(int ep) {
         domain->exportStepsOfTeam(best_perf_idx, "trained");
 }
 
+SimNE::TeamScore SimNE::scoreTeam(int ep, size_t n, IDomainStateful* d,
+    int* step, bool log, size_t n_final) {
+    MultiagentNE* mas = reinterpret_cast<MultiagentNE*>(MAS);
+    bool raced = n >= n_final;
+    TeamScore score;
+    score.stopped = false;
+    score.skipped = 0;
+    matrix1d sum;       // each agent's reward over the trials so far
+    matrix1d sum_sq;
+    for (int t = 0; t < n_trials; t++) {
+        RandomStreams::Scope draws(trialStream(ep, n, t));
+        // the most any trial can reward, read before it starts
+        matrix1d ceiling;
+        bool bounded = raced && d->rewardBound(&ceiling);
+        matrix1d bound;
+        for ((*step) = 0; (*step) < d->n_steps; (*step)++) {
+            if (d == domain) {
+                // must be called by 'this' in order to access potential
+                // child class overload
+                matrix2d A = this->getActions();
+                d->simulateStep(A);
+            } else {
+                d->simulateStep(mas->getTeamActions(n, d->getStates()));
+            }
+
+            if (log)
+                // Log positions of UAVs
+                d->logStep();
+
+            if (bounded && d->rewardBound(&bound)) {
+                // the trial mean, this trial at its bound and the ones
+                // still to come at the ceiling
+                for (size_t i = 0; i < bound.size(); i++) {
+                    double done = sum.empty() ? 0.0 : sum[i];
+                    bound[i] = (done + bound[i]
+                        + (n_trials - t - 1)*ceiling[i]) / n_trials;
+                }
+                if (mas->teamOutranked(n, bound, n_final)) {
+                    score.stopped = true;
+                    score.skipped = (n_trials - t)*d->n_steps - *step - 1;
+                    break;
+                }
+            }
+        }
+        if (score.stopped) {
+            d->reset();
+            score.R = matrix2d(1, bound);
+            score.perf.clear();
+            return score;
+        }
+
+        matrix1d R = d->getRewards();
+        score.R.push_back(R);
+        score.perf.push_back(easymath::mean(d->getPerformance()));
+        d->reset();
+        if (sum.empty()) {
+            sum.assign(R.size(), 0.0);
+            sum_sq.assign(R.size(), 0.0);
+        }
+        for (size_t i = 0; i < R.size(); i++) {
+            sum[i] += R[i];
+            sum_sq[i] += R[i]*R[i];
+        }
+
+        // statistical race: the mean plus trial_z_ standard errors
+        int k = t + 1;
+        if (raced && trial_z_ > 0 && k >= 2 && k < n_trials) {
+            matrix1d upper(R.size());
+            for (size_t i = 0; i < R.size(); i++) {
+                double mean = sum[i] / k;
+                double var = std::max(0.0,
+                    (sum_sq[i] - k*mean*mean) / (k - 1));
+                upper[i] = mean + trial_z_*sqrt(var / k);
+            }
+            if (mas->teamOutranked(n, upper, n_final)) {
+                score.stopped = true;
+                score.skipped = (n_trials - k)*d->n_steps;
+                score.R = matrix2d(1, upper);
+                score.perf.clear();
+                return score;
+            }
+        }
+    }
+    return score;
+}
+
+void SimNE::evaluateTeams(int ep, const vector<uint64_t> &keys,
+    size_t first, size_t last, size_t n_final, vector<TeamScore>* scores) {
+    MultiagentNE* mas = reinterpret_cast<MultiagentNE*>(MAS);
+    if (first == 0) mas->prepareTeams();
+    size_t n_teams = mas->nTeams();
+    last = std::min(last, n_teams);
+    scores->resize(n_teams);
+
+    // one task per replica, taking the next team in turn and running its
+    // trials; the pool runs as many at once as it has threads
+    std::atomic<size_t> next_team(first);
+    parallel::TaskGroup workers;
+    for (size_t w = 0; w < replicas_.size(); w++) {
+        workers.run([&, w] {
+            for (size_t n = next_team++; n < last; n = next_team++) {
+                if (!keys.empty() && keys[n] != 0
+                    && fitness_cache_.count(keys[n])) continue;
+                (*scores)[n] = scoreTeam(ep, n, replicas_[w],
+                    &replica_steps_[w], false, n_final);
+            }
+        });
+    }
+    workers.wait();
+}
+
 matrix2d SimNE::getActions() {
     matrix2d S = domain->getStates();
     return MAS->getActions(S);
 }
+
+void SimNE::runSteadyState(vector<IDomainStateful*> domains,
+    int n_evaluations, bool deterministic) {
+    if (n_evaluations <= 0) return;
+    if (domains.empty()) {
+        printf("SimNE: steady-state evolution needs at least one domain.");
+        system("pause");
+        exit(1);
+    }
+    MultiagentNE* mas = reinterpret_cast<MultiagentNE*>(MAS);
+    size_t n_workers = std::min(domains.size(),
+        static_cast<size_t>(NeuroEvoParameters::popSize));
+    vector<int> steps(n_workers, 0);
+    for (size_t w = 0; w < n_workers; w++) domains[w]->synch_step(&steps[w]);
+
+    // slots are handed to workers through queued and back through finished
+    vector<Evaluation> slots(n_workers);
+    vector<size_t> free_slots;
+    for (size_t i = n_workers; i > 0; i--) free_slots.push_back(i - 1);
+    std::deque<size_t> queued;
+    std::deque<size_t> finished;
+    bool stop = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    vector<std::thread> workers;
+    for (size_t w = 0; w < n_workers; w++) {
+        workers.push_back(std::thread([&, w] {
+            while (true) {
+                size_t slot;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&] {
+                        return stop || !queued.empty();
+                    });
+                    if (queued.empty()) return;
+                    slot = queued.front();
+                    queued.pop_front();
+                }
+                Evaluation &e = slots[slot];
+                e.R = evaluateCandidates(domains[w], &steps[w], e.seq,
+                    e.team, &e.perf);
+                std::lock_guard<std::mutex> lock(mutex);
+                e.done = true;
+                finished.push_back(slot);
+                changed.notify_all();
+            }
+        }));
+    }
+
+    int issued = 0;
+    int applied = 0;
+    double best_run = -DBL_MAX;
+    double best_run_performance = -DBL_MAX;
+    while (applied < n_evaluations) {
+        // keep every worker busy
+        while (issued < n_evaluations && !free_slots.empty()) {
+            size_t slot = free_slots.back();
+            free_slots.pop_back();
+            Evaluation &e = slots[slot];
+            e.seq = issued++;
+            e.team = mas->spawnCandidates();
+            e.done = false;
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(slot);
+            changed.notify_all();
+        }
+
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (deterministic) {
+                // the oldest team, whenever it finishes
+                changed.wait(lock, [&] {
+                    for (size_t s : finished) {
+                        if (slots[s].seq == applied) return true;
+                    }
+                    return false;
+                });
+                std::deque<size_t>::iterator it = finished.begin();
+                while (slots[*it].seq != applied) ++it;
+                slot = *it;
+                finished.erase(it);
+            } else {
+                changed.wait(lock, [&] { return !finished.empty(); });
+                slot = finished.front();
+                finished.pop_front();
+            }
+        }
+        Evaluation &e = slots[slot];
+        mas->resolveCandidates(e.team, e.R);
+        free_slots.push_back(slot);
+
+        double avg_G = easymath::mean(e.R);
+        best_run = std::max(best_run, avg_G);
+        best_run_performance = std::max(best_run_performance, e.perf);
+        printf("NN#%i, %f, %f, %f\n", e.seq, best_run_performance,
+            best_run, e.perf);
+        if (++applied % NeuroEvoParameters::popSize == 0
+            || applied == n_evaluations) {
+            reward_log.push_back(best_run);
+            metric_log.push_back(best_run_performance);
+            best_run = -DBL_MAX;
+            best_run_performance = -DBL_MAX;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        changed.notify_all();
+    }
+    for (std::thread &t : workers) t.join();
+    domain->synch_step(step);
+}
+
+matrix1d SimNE::evaluateCandidates(IDomainStateful* d, int* step, int seq,
+    const vector<size_t> &team, double* perf) {
+    MultiagentNE* mas = reinterpret_cast<MultiagentNE*>(MAS);
+    matrix2d Rtrials;   // Trial average reward
+    double perf_sum = 0.0;
+    for (int t = 0; t < n_trials; t++) {
+        RandomStreams::Scope draws(
+            RandomStreams::stream(RandomStreams::CANDIDATE, seq, t));
+        for ((*step) = 0; (*step) < d->n_steps; (*step)++) {
+            matrix2d A = mas->getCandidateActions(team, d->getStates());
+            d->simulateStep(A);
+        }
+        Rtrials.push_back(d->getRewards());
+        perf_sum += easymath::mean(d->getPerformance());
+        d->reset();
+    }
+    *perf = perf_sum / n_trials;
+    return easymath::mean2(Rtrials);
+}
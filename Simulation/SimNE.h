@@ -8,6 +8,8 @@
 // C++
 #include <sstream>
 #include <limits>
+#include <map>
+#include <vector>
 
 // Libraries
 #include "ISimulator.h"
@@ -26,7 +28,103 @@ class SimNE : public ISimulator {
 
     virtual void runExperiment();
     virtual void epoch(int ep);
+    //! Parallel epochs: the teams are scored on the shared thread pool,
+    //! up to n_workers at once, each simulating on its own replica of the
+    //! domain (IDomainStateful::clone), and their rewards are then applied
+    //! in team order, as the serial loop would. Epochs that log steps stay
+    //! on the main domain. Returns false, staying serial, if the domain
+    //! cannot be replicated.
+    virtual bool setWorkers(size_t n_workers);
+    //! Fitness cache for epochs: a team whose members all have keys
+    //! (MultiagentNE::teamKey) and that was scored in the epoch before,
+    //! survivors together, takes that score instead of being simulated
+    //! again. Keys include the domain's configurationKey and the seed,
+    //! and every team's trial t draws from one stream
+    //! (RandomStreams::COMMON), so a cached score is what simulating again
+    //! would give. The cache stays off for a stochastic() domain unless
+    //! reevaluate_stochastic is false, as otherwise a survivor's one lucky
+    //! sample would stand. Epochs that log steps simulate every team.
+    void setFitnessCache(bool on, bool reevaluate_stochastic = true);
+    bool fitnessCacheActive() const;
+    //! teams looked up and found since the cache was last switched on
+    size_t cacheLookups() const { return cache_lookups_; }
+    size_t cacheHits() const { return cache_hits_; }
+    double cacheHitRate() const;
+    //! Racing: once an epoch's survivors (its first popSize teams) are
+    //! rewarded, each new team's episode is stopped as soon as it can no
+    //! longer displace any of them (MultiagentNE::teamOutranked), its
+    //! members taking the bound as their reward. The bound is the
+    //! domain's rewardBound, checked every step; a domain or reward mode
+    //! without one runs every team in full. With trial_z > 0 teams are
+    //! also raced across trials: after two or more, one whose mean reward
+    //! plus trial_z standard errors cannot survive is stopped. Unlike the
+    //! bound, that test can drop a team that would have survived. Epochs
+    //! that log steps run every team in full.
+    void setRacing(bool on, double trial_z = 0.0);
+    //! teams stopped early, and the steps they were spared
+    size_t teamsStopped() const { return teams_stopped_; }
+    size_t stepsSkipped() const { return steps_skipped_; }
+    //! Steady-state evolution instead of epochs: one worker thread per
+    //! domain (up to popSize) evaluates candidate teams continuously, and
+    //! each result goes through the agents' replacement tournament as it
+    //! comes in. Domains must not share state. With deterministic set,
+    //! results are applied in the order the teams were made and team k
+    //! is made once the results before k - n_workers are in, so a run
+    //! repeats whatever the timing (the domains drawing from the
+    //! candidate's RandomStreams). Logs the
+    //! best reward and performance of each popSize evaluations.
+    void runSteadyState(std::vector<IDomainStateful*> domains,
+        int n_evaluations, bool deterministic = false);
     //! Gets actions based on current state: OVERLOAD FOR TYPES
     virtual matrix2d getActions();
+
+ private:
+    //! the worker domains of setWorkers, and their step counters
+    std::vector<IDomainStateful*> replicas_;
+    std::vector<int> replica_steps_;
+    //! A team's rewards and mean performance, by trial. A stopped team
+    //! has one row of R, the bound it was stopped on, and no perf.
+    struct TeamScore {
+        matrix2d R;
+        matrix1d perf;
+        bool stopped;
+        size_t skipped;  // steps not simulated
+    };
+    //! Runs team n's trials on d, which counts steps in step: the main
+    //! domain through getActions() (logging steps if log), or a replica
+    //! through getTeamActions. Teams from n_final on are raced.
+    TeamScore scoreTeam(int ep, size_t n, IDomainStateful* d, int* step,
+        bool log, size_t n_final);
+    //! Scores teams first .. last - 1, up to the last team, on the
+    //! replicas, but for those in the fitness cache
+    void evaluateTeams(int ep, const std::vector<uint64_t> &keys,
+        size_t first, size_t last, size_t n_final,
+        std::vector<TeamScore>* scores);
+    //! draws for trial t of team n in epoch ep
+    easymath::Philox trialStream(int ep, size_t n, int t) const;
+
+    bool racing_;
+    double trial_z_;
+    size_t teams_stopped_;
+    size_t steps_skipped_;
+
+    //! a team's scores (never a stopped one), and the last epoch that
+    //! used them
+    struct CachedFitness {
+        TeamScore score;
+        int epoch;
+    };
+    std::map<uint64_t, CachedFitness> fitness_cache_;
+    bool cache_on_;
+    bool reevaluate_stochastic_;
+    size_t cache_lookups_;
+    size_t cache_hits_;
+    //! each team's cache key, or 0 where it cannot be cached
+    std::vector<uint64_t> teamKeys();
+
+    //! n_trials episodes of candidate team seq on d, which counts steps in
+    //! step: the agents' mean rewards, and the mean performance in perf
+    matrix1d evaluateCandidates(IDomainStateful* d, int* step, int seq,
+        const std::vector<size_t> &team, double* perf);
 };
 #endif  // SIMULATION_SIMNE_H_
@@ -15,5 +15,7 @@ class SimTypeNE : public SimNE {
     NeuroEvoParameters* NE_params;
     MultiagentTypeNE::TypeHandling type_mode;
     virtual matrix2d getActions();
+    //! Serial only: the type states go through getActions()
+    virtual bool setWorkers(size_t) { return false; }
 };
 #endif  // SIMULATION_SIMTYPENE_H_
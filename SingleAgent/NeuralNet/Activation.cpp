@@ -0,0 +1,448 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "Activation.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "DenseKernels.h"
+#include "KernelTargets.h"
+
+namespace nnkernels {
+namespace {
+Accuracy g_accuracy = EXACT;
+
+// exp(t) = 2^n * exp(r), n = round(t/ln2), |r| <= ln2/2. ln2 is split so
+// that n*LN2_HI is exact.
+const double LOG2E = 1.4426950408889634;
+const double LN2_HI = 6.93147180369123816490e-01;
+const double LN2_LO = 1.90821492927058770002e-10;
+// exp overflows past this; the sigmoid is 0 or 1 to double precision anyway
+const double EXP_LIMIT = 708.0;
+// Taylor coefficients 1/k! for k = 9 down to 2
+const double C9 = 1.0 / 362880.0;
+const double C8 = 1.0 / 40320.0;
+const double C7 = 1.0 / 5040.0;
+const double C6 = 1.0 / 720.0;
+const double C5 = 1.0 / 120.0;
+const double C4 = 1.0 / 24.0;
+const double C3 = 1.0 / 6.0;
+const double C2 = 0.5;
+// 1.5*2^52: adding it leaves a small integer in the low mantissa bits
+const double ROUND_MAGIC = 6755399441055744.0;
+
+// The same for float. Degree 7 is as far as float precision goes here.
+const float LOG2E_F = 1.44269504f;
+const float LN2_HI_F = 0.693359375f;
+const float LN2_LO_F = -2.12194440e-4f;
+// 2^k stays a normal float for |k| <= 126
+const float EXP_LIMIT_F = 87.0f;
+const float C7_F = 1.0f / 5040.0f;
+const float C6_F = 1.0f / 720.0f;
+const float C5_F = 1.0f / 120.0f;
+const float C4_F = 1.0f / 24.0f;
+const float C3_F = 1.0f / 6.0f;
+const float C2_F = 0.5f;
+
+// The table covers [-TABLE_RANGE, TABLE_RANGE] in steps of 1/TABLE_STEPS
+const int TABLE_RANGE = 16;
+const int TABLE_STEPS = 64;
+const int TABLE_SIZE = 2 * TABLE_RANGE * TABLE_STEPS;
+
+template <class Scalar>
+struct SigmoidTable {
+    // value at each knot and the slope to the next one
+    Scalar value[TABLE_SIZE + 1];
+    Scalar slope[TABLE_SIZE + 1];
+    SigmoidTable() {
+        for (int i = 0; i <= TABLE_SIZE; i++) {
+            double x = -TABLE_RANGE + static_cast<double>(i) / TABLE_STEPS;
+            value[i] = static_cast<Scalar>(1 / (1 + exp(-x)));
+        }
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            slope[i] = value[i + 1] - value[i];
+        }
+        slope[TABLE_SIZE] = 0;
+    }
+};
+
+template <class Scalar>
+const SigmoidTable<Scalar>& table() {
+    static SigmoidTable<Scalar> t;
+    return t;
+}
+
+// Every mode, one element at a time. The vector kernels compute the same
+// operations in the same order, so they agree with this on every element.
+NN_NOINLINE void sigmoid_scalar(double* x, double* d, int n, Accuracy a) {
+    const SigmoidTable<double>& tab = table<double>();
+    for (int i = 0; i < n; i++) {
+        double y;
+        if (a == EXACT) {
+            y = 1 / (1 + exp(-x[i]));
+        } else if (a == POLYNOMIAL) {
+            double t = -x[i];
+            t = (t < -EXP_LIMIT) ? -EXP_LIMIT : t;
+            t = (t > EXP_LIMIT) ? EXP_LIMIT : t;
+            double k = std::nearbyint(t*LOG2E);
+            double r = (t - k*LN2_HI) - k*LN2_LO;
+            double p = C9;
+            p = p*r + C8;
+            p = p*r + C7;
+            p = p*r + C6;
+            p = p*r + C5;
+            p = p*r + C4;
+            p = p*r + C3;
+            p = p*r + C2;
+            p = p*r + 1.0;
+            p = p*r + 1.0;
+            uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(k)
+                + 1023) << 52;
+            double scale;
+            memcpy(&scale, &bits, sizeof(scale));
+            y = 1 / (1 + p*scale);
+        } else {
+            double u = (x[i] + TABLE_RANGE)*TABLE_STEPS;
+            u = (u < 0.0) ? 0.0 : u;
+            u = (u > TABLE_SIZE) ? TABLE_SIZE : u;
+            int k = static_cast<int>(u);
+            k = (k > TABLE_SIZE - 1) ? TABLE_SIZE - 1 : k;
+            double f = u - k;
+            y = tab.value[k] + f*tab.slope[k];
+        }
+        x[i] = y;
+        if (d) d[i] = y*(1 - y);
+    }
+}
+
+// The float modes in float arithmetic, but for EXACT, which rounds the
+// double result
+NN_NOINLINE void sigmoid_scalar(float* x, float* d, int n, Accuracy a) {
+    const SigmoidTable<float>& tab = table<float>();
+    for (int i = 0; i < n; i++) {
+        float y;
+        if (a == EXACT) {
+            y = static_cast<float>(1 / (1 + exp(-static_cast<double>(x[i]))));
+        } else if (a == POLYNOMIAL) {
+            float t = -x[i];
+            t = (t < -EXP_LIMIT_F) ? -EXP_LIMIT_F : t;
+            t = (t > EXP_LIMIT_F) ? EXP_LIMIT_F : t;
+            float k = std::nearbyint(t*LOG2E_F);
+            float r = (t - k*LN2_HI_F) - k*LN2_LO_F;
+            float p = C7_F;
+            p = p*r + C6_F;
+            p = p*r + C5_F;
+            p = p*r + C4_F;
+            p = p*r + C3_F;
+            p = p*r + C2_F;
+            p = p*r + 1.0f;
+            p = p*r + 1.0f;
+            uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(k)
+                + 127) << 23;
+            float scale;
+            memcpy(&scale, &bits, sizeof(scale));
+            y = 1 / (1 + p*scale);
+        } else {
+            float u = (x[i] + TABLE_RANGE)*TABLE_STEPS;
+            u = (u < 0.0f) ? 0.0f : u;
+            u = (u > TABLE_SIZE) ? TABLE_SIZE : u;
+            int k = static_cast<int>(u);
+            k = (k > TABLE_SIZE - 1) ? TABLE_SIZE - 1 : k;
+            float f = u - k;
+            y = tab.value[k] + f*tab.slope[k];
+        }
+        x[i] = y;
+        if (d) d[i] = y*(1 - y);
+    }
+}
+
+#ifndef NN_NO_X86
+NN_TARGET_AVX2 inline __m256d poly_avx2(__m256d x) {
+    __m256d t = _mm256_sub_pd(_mm256_setzero_pd(), x);
+    t = _mm256_max_pd(t, _mm256_set1_pd(-EXP_LIMIT));
+    t = _mm256_min_pd(t, _mm256_set1_pd(EXP_LIMIT));
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(t, _mm256_set1_pd(LOG2E)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_sub_pd(t, _mm256_mul_pd(k, _mm256_set1_pd(LN2_HI)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(LN2_LO)));
+    const double c[] = { C8, C7, C6, C5, C4, C3, C2, 1.0, 1.0 };
+    __m256d p = _mm256_set1_pd(C9);
+    for (int j = 0; j < 9; j++) {
+        p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(c[j]));
+    }
+    // 2^k: k sits in the low mantissa bits after adding ROUND_MAGIC
+    __m256i bits = _mm256_castpd_si256(
+        _mm256_add_pd(k, _mm256_set1_pd(ROUND_MAGIC)));
+    bits = _mm256_slli_epi64(
+        _mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+    __m256d e = _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+    __m256d one = _mm256_set1_pd(1.0);
+    return _mm256_div_pd(one, _mm256_add_pd(one, e));
+}
+
+NN_TARGET_AVX2 inline __m256d table_avx2(__m256d x,
+    const SigmoidTable<double>& tab) {
+    __m256d u = _mm256_mul_pd(_mm256_add_pd(x, _mm256_set1_pd(TABLE_RANGE)),
+        _mm256_set1_pd(TABLE_STEPS));
+    u = _mm256_max_pd(u, _mm256_setzero_pd());
+    u = _mm256_min_pd(u, _mm256_set1_pd(TABLE_SIZE));
+    __m128i k = _mm_min_epi32(_mm256_cvttpd_epi32(u),
+        _mm_set1_epi32(TABLE_SIZE - 1));
+    __m256d f = _mm256_sub_pd(u, _mm256_cvtepi32_pd(k));
+    __m256d v = _mm256_i32gather_pd(tab.value, k, 8);
+    __m256d s = _mm256_i32gather_pd(tab.slope, k, 8);
+    return _mm256_add_pd(v, _mm256_mul_pd(f, s));
+}
+
+NN_TARGET_AVX2 void sigmoid_avx2(double* x, double* d, int n, Accuracy a) {
+    const SigmoidTable<double>& tab = table<double>();
+    __m256d one = _mm256_set1_pd(1.0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(x + i);
+        __m256d y = (a == TABLE) ? table_avx2(v, tab) : poly_avx2(v);
+        _mm256_storeu_pd(x + i, y);
+        if (d) {
+            _mm256_storeu_pd(d + i, _mm256_mul_pd(y, _mm256_sub_pd(one, y)));
+        }
+    }
+    sigmoid_scalar(x + i, d ? d + i : NULL, n - i, a);
+}
+
+NN_TARGET_AVX512 inline __m512d poly_avx512(__m512d x) {
+    __m512d t = _mm512_sub_pd(_mm512_setzero_pd(), x);
+    t = _mm512_max_pd(t, _mm512_set1_pd(-EXP_LIMIT));
+    t = _mm512_min_pd(t, _mm512_set1_pd(EXP_LIMIT));
+    __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(t, _mm512_set1_pd(LOG2E)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_sub_pd(t, _mm512_mul_pd(k, _mm512_set1_pd(LN2_HI)));
+    r = _mm512_sub_pd(r, _mm512_mul_pd(k, _mm512_set1_pd(LN2_LO)));
+    const double c[] = { C8, C7, C6, C5, C4, C3, C2, 1.0, 1.0 };
+    __m512d p = _mm512_set1_pd(C9);
+    for (int j = 0; j < 9; j++) {
+        p = _mm512_add_pd(_mm512_mul_pd(p, r), _mm512_set1_pd(c[j]));
+    }
+    __m512i bits = _mm512_castpd_si512(
+        _mm512_add_pd(k, _mm512_set1_pd(ROUND_MAGIC)));
+    bits = _mm512_slli_epi64(
+        _mm512_add_epi64(bits, _mm512_set1_epi64(1023)), 52);
+    __m512d e = _mm512_mul_pd(p, _mm512_castsi512_pd(bits));
+    __m512d one = _mm512_set1_pd(1.0);
+    return _mm512_div_pd(one, _mm512_add_pd(one, e));
+}
+
+NN_TARGET_AVX512 inline __m512d table_avx512(__m512d x,
+    const SigmoidTable<double>& tab) {
+    __m512d u = _mm512_mul_pd(_mm512_add_pd(x, _mm512_set1_pd(TABLE_RANGE)),
+        _mm512_set1_pd(TABLE_STEPS));
+    u = _mm512_max_pd(u, _mm512_setzero_pd());
+    u = _mm512_min_pd(u, _mm512_set1_pd(TABLE_SIZE));
+    __m256i k = _mm256_min_epi32(_mm512_cvttpd_epi32(u),
+        _mm256_set1_epi32(TABLE_SIZE - 1));
+    __m512d f = _mm512_sub_pd(u, _mm512_cvtepi32_pd(k));
+    __m512d v = _mm512_i32gather_pd(k, tab.value, 8);
+    __m512d s = _mm512_i32gather_pd(k, tab.slope, 8);
+    return _mm512_add_pd(v, _mm512_mul_pd(f, s));
+}
+
+NN_TARGET_AVX512 void sigmoid_avx512(double* x, double* d, int n,
+    Accuracy a) {
+    const SigmoidTable<double>& tab = table<double>();
+    __m512d one = _mm512_set1_pd(1.0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d v = _mm512_loadu_pd(x + i);
+        __m512d y = (a == TABLE) ? table_avx512(v, tab) : poly_avx512(v);
+        _mm512_storeu_pd(x + i, y);
+        if (d) {
+            _mm512_storeu_pd(d + i, _mm512_mul_pd(y, _mm512_sub_pd(one, y)));
+        }
+    }
+    sigmoid_scalar(x + i, d ? d + i : NULL, n - i, a);
+}
+
+// Float kernels: eight lanes per AVX2 register and sixteen per AVX-512
+NN_TARGET_AVX2 inline __m256 poly_avx2(__m256 x) {
+    __m256 t = _mm256_sub_ps(_mm256_setzero_ps(), x);
+    t = _mm256_max_ps(t, _mm256_set1_ps(-EXP_LIMIT_F));
+    t = _mm256_min_ps(t, _mm256_set1_ps(EXP_LIMIT_F));
+    __m256 k = _mm256_round_ps(_mm256_mul_ps(t, _mm256_set1_ps(LOG2E_F)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_sub_ps(t, _mm256_mul_ps(k, _mm256_set1_ps(LN2_HI_F)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(LN2_LO_F)));
+    const float c[] = { C6_F, C5_F, C4_F, C3_F, C2_F, 1.0f, 1.0f };
+    __m256 p = _mm256_set1_ps(C7_F);
+    for (int j = 0; j < 7; j++) {
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(c[j]));
+    }
+    __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(
+        _mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+    __m256 e = _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+    __m256 one = _mm256_set1_ps(1.0f);
+    return _mm256_div_ps(one, _mm256_add_ps(one, e));
+}
+
+NN_TARGET_AVX2 inline __m256 table_avx2(__m256 x,
+    const SigmoidTable<float>& tab) {
+    __m256 u = _mm256_mul_ps(_mm256_add_ps(x, _mm256_set1_ps(TABLE_RANGE)),
+        _mm256_set1_ps(TABLE_STEPS));
+    u = _mm256_max_ps(u, _mm256_setzero_ps());
+    u = _mm256_min_ps(u, _mm256_set1_ps(TABLE_SIZE));
+    __m256i k = _mm256_min_epi32(_mm256_cvttps_epi32(u),
+        _mm256_set1_epi32(TABLE_SIZE - 1));
+    __m256 f = _mm256_sub_ps(u, _mm256_cvtepi32_ps(k));
+    __m256 v = _mm256_i32gather_ps(tab.value, k, 4);
+    __m256 s = _mm256_i32gather_ps(tab.slope, k, 4);
+    return _mm256_add_ps(v, _mm256_mul_ps(f, s));
+}
+
+NN_TARGET_AVX2 void sigmoid_avx2(float* x, float* d, int n, Accuracy a) {
+    const SigmoidTable<float>& tab = table<float>();
+    __m256 one = _mm256_set1_ps(1.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 y = (a == TABLE) ? table_avx2(v, tab) : poly_avx2(v);
+        _mm256_storeu_ps(x + i, y);
+        if (d) {
+            _mm256_storeu_ps(d + i, _mm256_mul_ps(y, _mm256_sub_ps(one, y)));
+        }
+    }
+    sigmoid_scalar(x + i, d ? d + i : NULL, n - i, a);
+}
+
+NN_TARGET_AVX512 inline __m512 poly_avx512(__m512 x) {
+    __m512 t = _mm512_sub_ps(_mm512_setzero_ps(), x);
+    t = _mm512_max_ps(t, _mm512_set1_ps(-EXP_LIMIT_F));
+    t = _mm512_min_ps(t, _mm512_set1_ps(EXP_LIMIT_F));
+    __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(t, _mm512_set1_ps(LOG2E_F)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_sub_ps(t, _mm512_mul_ps(k, _mm512_set1_ps(LN2_HI_F)));
+    r = _mm512_sub_ps(r, _mm512_mul_ps(k, _mm512_set1_ps(LN2_LO_F)));
+    const float c[] = { C6_F, C5_F, C4_F, C3_F, C2_F, 1.0f, 1.0f };
+    __m512 p = _mm512_set1_ps(C7_F);
+    for (int j = 0; j < 7; j++) {
+        p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(c[j]));
+    }
+    __m512i bits = _mm512_slli_epi32(_mm512_add_epi32(
+        _mm512_cvtps_epi32(k), _mm512_set1_epi32(127)), 23);
+    __m512 e = _mm512_mul_ps(p, _mm512_castsi512_ps(bits));
+    __m512 one = _mm512_set1_ps(1.0f);
+    return _mm512_div_ps(one, _mm512_add_ps(one, e));
+}
+
+NN_TARGET_AVX512 inline __m512 table_avx512(__m512 x,
+    const SigmoidTable<float>& tab) {
+    __m512 u = _mm512_mul_ps(_mm512_add_ps(x, _mm512_set1_ps(TABLE_RANGE)),
+        _mm512_set1_ps(TABLE_STEPS));
+    u = _mm512_max_ps(u, _mm512_setzero_ps());
+    u = _mm512_min_ps(u, _mm512_set1_ps(TABLE_SIZE));
+    __m512i k = _mm512_min_epi32(_mm512_cvttps_epi32(u),
+        _mm512_set1_epi32(TABLE_SIZE - 1));
+    __m512 f = _mm512_sub_ps(u, _mm512_cvtepi32_ps(k));
+    __m512 v = _mm512_i32gather_ps(k, tab.value, 4);
+    __m512 s = _mm512_i32gather_ps(k, tab.slope, 4);
+    return _mm512_add_ps(v, _mm512_mul_ps(f, s));
+}
+
+NN_TARGET_AVX512 void sigmoid_avx512(float* x, float* d, int n,
+    Accuracy a) {
+    const SigmoidTable<float>& tab = table<float>();
+    __m512 one = _mm512_set1_ps(1.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(x + i);
+        __m512 y = (a == TABLE) ? table_avx512(v, tab) : poly_avx512(v);
+        _mm512_storeu_ps(x + i, y);
+        if (d) {
+            _mm512_storeu_ps(d + i, _mm512_mul_ps(y, _mm512_sub_ps(one, y)));
+        }
+    }
+    sigmoid_scalar(x + i, d ? d + i : NULL, n - i, a);
+}
+#endif
+
+template <class Scalar>
+void apply(Scalar* x, Scalar* d, int n, Accuracy a) {
+    // libm has no vector exp we can match, so EXACT stays scalar
+    if (a == EXACT) {
+        sigmoid_scalar(x, d, n, a);
+        return;
+    }
+    switch (active_isa()) {
+#ifndef NN_NO_X86
+    case AVX512:
+        sigmoid_avx512(x, d, n, a);
+        break;
+    case AVX2:
+        sigmoid_avx2(x, d, n, a);
+        break;
+#endif
+    default:
+        sigmoid_scalar(x, d, n, a);
+    }
+}
+
+}  // namespace
+
+Accuracy accuracy() {
+    return g_accuracy;
+}
+
+void set_accuracy(Accuracy a) {
+    g_accuracy = a;
+}
+
+const char* accuracy_name(Accuracy a) {
+    static const char* names[NACCURACIES] = { "exact", "polynomial", "table" };
+    return names[a];
+}
+
+void sigmoid(double* x, int n) {
+    apply<double>(x, NULL, n, g_accuracy);
+}
+
+void sigmoid(float* x, int n) {
+    apply<float>(x, NULL, n, g_accuracy);
+}
+
+void sigmoid_deriv(double* x, double* d, int n) {
+    apply(x, d, n, g_accuracy);
+}
+
+void sigmoid_deriv(float* x, float* d, int n) {
+    apply(x, d, n, g_accuracy);
+}
+
+ActivationError activation_error(Accuracy a, double lo, double hi,
+    int samples) {
+    std::vector<double> x(samples);
+    for (int i = 0; i < samples; i++) {
+        x[i] = (samples > 1) ? lo + (hi - lo)*i / (samples - 1) : lo;
+    }
+    std::vector<double> y(x);
+    apply<double>(y.data(), NULL, samples, a);
+
+    ActivationError err = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < samples; i++) {
+        double ref = 1 / (1 + exp(-x[i]));
+        double abs_err = fabs(y[i] - ref);
+        if (abs_err > err.max_abs) err.max_abs = abs_err;
+        if (abs_err / ref > err.max_rel) err.max_rel = abs_err / ref;
+        err.mean_abs += abs_err;
+    }
+    if (samples > 0) err.mean_abs /= samples;
+    return err;
+}
+
+void print_activation_errors() {
+    printf("sigmoid error vs libm on [-20, 20] (%s):\n",
+        isa_name(active_isa()));
+    for (int a = 0; a < NACCURACIES; a++) {
+        ActivationError e = activation_error(static_cast<Accuracy>(a));
+        printf("  %-10s max %.3e  mean %.3e  max rel %.3e\n",
+            accuracy_name(static_cast<Accuracy>(a)), e.max_abs, e.mean_abs,
+            e.max_rel);
+    }
+}
+}  // namespace nnkernels
@@ -0,0 +1,48 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_ACTIVATION_H_
+#define SINGLEAGENT_NEURALNET_ACTIVATION_H_
+
+/**
+* Logistic sigmoid for the NeuralNet layers, over raw arrays and vectorized
+* with the instruction set picked in DenseKernels. EXACT calls libm exp and
+* is what the networks have always computed. POLYNOMIAL and TABLE trade
+* accuracy for speed; use activation_error to see how much.
+*/
+
+namespace nnkernels {
+enum Accuracy {
+    EXACT,  // 1/(1+exp(-x)) through libm
+    POLYNOMIAL,  // range-reduced degree-9 polynomial for exp, ~2e-12 abs
+    TABLE,  // linear interpolation on [-16, 16] in 1/64 steps, ~3e-6 abs
+    NACCURACIES
+};
+
+Accuracy accuracy();
+void set_accuracy(Accuracy a);
+const char* accuracy_name(Accuracy a);
+
+//! x[i] = 1/(1+exp(-x[i]))
+void sigmoid(double* x, int n);
+//! POLYNOMIAL and TABLE run in float, twice as many lanes per vector as
+//! double, to within a few float ulps and ~3e-6 abs. EXACT is evaluated in
+//! double and rounded, as for double nets.
+void sigmoid(float* x, int n);
+
+//! sigmoid, also writing its derivative d[i] = y*(1-y) in the same pass
+void sigmoid_deriv(double* x, double* d, int n);
+void sigmoid_deriv(float* x, float* d, int n);
+
+struct ActivationError {
+    double max_abs;
+    double mean_abs;
+    double max_rel;
+};
+
+//! Error of a mode against libm at samples evenly spaced points of [lo, hi]
+ActivationError activation_error(Accuracy a, double lo = -20.0,
+    double hi = 20.0, int samples = 100001);
+
+//! Prints the activation_error of every mode
+void print_activation_errors();
+}  // namespace nnkernels
+#endif  // SINGLEAGENT_NEURALNET_ACTIVATION_H_
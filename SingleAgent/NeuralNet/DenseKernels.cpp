@@ -0,0 +1,686 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "DenseKernels.h"
+#include "KernelTargets.h"
+
+namespace nnkernels {
+namespace {
+// Blocking for matmat: KC rows of B (one panel) are reused across MC rows
+// of A before moving on; both are sized to sit in L2 for our layer widths
+const int KC = 256;
+const int MC = 64;
+// Rows of A sharing each load of B in the register tiles
+const int MR = 4;
+
+Mode g_mode = STRICT;
+
+// The kernels selected for one scalar type
+template <class T>
+struct Kernels {
+    typedef void(*vecmat_fn)(const T*, int, const T*, int, T*);
+    typedef void(*sparse_fn)(const int*, const T*, int, const T*, int, T*);
+    typedef void(*member_fn)(const T*, int, const T*, int, int, T*);
+    typedef void(*tile_fn)(const T*, int, int, int, const T*, int, T*,
+        bool);
+    vecmat_fn vecmat;
+    sparse_fn sparse;
+    member_fn member;
+    tile_fn tile;
+};
+
+// The rows vecmat sums, in order: row k of B weighted by a[k] ...
+template <class T>
+struct DenseRows {
+    const T* a;
+    const T* B;
+    int cols;
+    T weight(int k) const { return a[k]; }
+    const T* row(int k) const { return B + static_cast<size_t>(k)*cols; }
+};
+
+// ... or, for sparse_vecmat, row index[k] weighted by value[k]
+template <class T>
+struct SparseRows {
+    const int* index;
+    const T* value;
+    const T* B;
+    int cols;
+    T weight(int k) const { return value[k]; }
+    const T* row(int k) const {
+        return B + static_cast<size_t>(index[k])*cols;
+    }
+};
+
+// Columns [col_begin, cols) of vecmat over n rows. Never inlined into the
+// vector kernels, so the tails cannot be contracted into fused
+// multiply-adds.
+template <class T, class Rows>
+NN_NOINLINE void vecmat_cols(Rows r, int n, int cols, T* c,
+    int col_begin) {
+    for (int col = col_begin; col < cols; col++) {
+        c[col] = 0;
+    }
+    for (int k = 0; k < n; k++) {
+        T ai = r.weight(k);
+        const T* b = r.row(k);
+        for (int col = col_begin; col < cols; col++) {
+            c[col] += ai * b[col];
+        }
+    }
+}
+
+template <class T>
+void vecmat_scalar(const T* a, int rows, const T* B, int cols, T* c) {
+    DenseRows<T> r = { a, B, cols };
+    vecmat_cols<T>(r, rows, cols, c, 0);
+}
+
+template <class T>
+void sparse_vecmat_scalar(const int* index, const T* value, int n,
+    const T* B, int cols, T* c) {
+    SparseRows<T> r = { index, value, B, cols };
+    vecmat_cols<T>(r, n, cols, c, 0);
+}
+
+// Rows [0, m) and columns [col_begin, N) of a matmat tile: k runs over
+// [0, kc) of the panels A (stride K) and B (stride N). Adds to C if
+// accumulate, otherwise overwrites it.
+template <class T>
+NN_NOINLINE void tile_cols(const T* A, int m, int K, int kc, const T* B,
+    int N, T* C, int col_begin, bool accumulate) {
+    for (int r = 0; r < m; r++) {
+        T* c = C + r*N;
+        if (!accumulate) {
+            for (int col = col_begin; col < N; col++) {
+                c[col] = 0;
+            }
+        }
+        for (int k = 0; k < kc; k++) {
+            T a = A[r*K + k];
+            const T* b = B + k*N;
+            for (int col = col_begin; col < N; col++) {
+                c[col] += a * b[col];
+            }
+        }
+    }
+}
+
+template <class T>
+void tile_scalar(const T* A, int m, int K, int kc, const T* B, int N, T* C,
+    bool accumulate) {
+    tile_cols(A, m, K, kc, B, N, C, 0, accumulate);
+}
+
+template <class T>
+NN_NOINLINE void member_vecmat_scalar(const T* a, int rows, const T* B,
+    int cols, int members, T* c) {
+    for (int i = 0; i < cols*members; i++) {
+        c[i] = 0;
+    }
+    for (int inner = 0; inner < rows; inner++) {
+        const T* ai = a + inner*members;
+        const T* b = B + inner*cols*members;
+        for (int col = 0; col < cols; col++) {
+            T* cc = c + col*members;
+            const T* bb = b + col*members;
+            for (int m = 0; m < members; m++) {
+                cc[m] += ai[m] * bb[m];
+            }
+        }
+    }
+}
+
+#ifndef NN_NO_X86
+// Register type and operations for each instruction set and scalar type,
+// so that every kernel below is written once for float and double. W is
+// the number of lanes in a register.
+template <class T> struct Avx2;
+
+template <> struct Avx2<double> {
+    typedef __m256d V;
+    static const int W = 4;
+    NN_TARGET_AVX2 static V zero() { return _mm256_setzero_pd(); }
+    NN_TARGET_AVX2 static V set1(double x) { return _mm256_set1_pd(x); }
+    NN_TARGET_AVX2 static V load(const double* p) {
+        return _mm256_loadu_pd(p);
+    }
+    NN_TARGET_AVX2 static void store(double* p, V v) {
+        _mm256_storeu_pd(p, v);
+    }
+    template <bool Fused>
+    NN_TARGET_AVX2 static V madd(V a, V b, V acc) {
+        return Fused ? _mm256_fmadd_pd(a, b, acc)
+            : _mm256_add_pd(acc, _mm256_mul_pd(a, b));
+    }
+};
+
+template <> struct Avx2<float> {
+    typedef __m256 V;
+    static const int W = 8;
+    NN_TARGET_AVX2 static V zero() { return _mm256_setzero_ps(); }
+    NN_TARGET_AVX2 static V set1(float x) { return _mm256_set1_ps(x); }
+    NN_TARGET_AVX2 static V load(const float* p) {
+        return _mm256_loadu_ps(p);
+    }
+    NN_TARGET_AVX2 static void store(float* p, V v) {
+        _mm256_storeu_ps(p, v);
+    }
+    template <bool Fused>
+    NN_TARGET_AVX2 static V madd(V a, V b, V acc) {
+        return Fused ? _mm256_fmadd_ps(a, b, acc)
+            : _mm256_add_ps(acc, _mm256_mul_ps(a, b));
+    }
+};
+
+// AVX-512 adds masked loads and stores for the right edge of a row
+template <class T> struct Avx512;
+
+template <> struct Avx512<double> {
+    typedef __m512d V;
+    typedef __mmask8 M;
+    static const int W = 8;
+    NN_TARGET_AVX512 static V zero() { return _mm512_setzero_pd(); }
+    NN_TARGET_AVX512 static V set1(double x) { return _mm512_set1_pd(x); }
+    NN_TARGET_AVX512 static V load(const double* p) {
+        return _mm512_loadu_pd(p);
+    }
+    NN_TARGET_AVX512 static void store(double* p, V v) {
+        _mm512_storeu_pd(p, v);
+    }
+    NN_TARGET_AVX512 static V load(M m, const double* p) {
+        return _mm512_maskz_loadu_pd(m, p);
+    }
+    NN_TARGET_AVX512 static void store(double* p, M m, V v) {
+        _mm512_mask_storeu_pd(p, m, v);
+    }
+    template <bool Fused>
+    NN_TARGET_AVX512 static V madd(V a, V b, V acc) {
+        return Fused ? _mm512_fmadd_pd(a, b, acc)
+            : _mm512_add_pd(acc, _mm512_mul_pd(a, b));
+    }
+};
+
+template <> struct Avx512<float> {
+    typedef __m512 V;
+    typedef __mmask16 M;
+    static const int W = 16;
+    NN_TARGET_AVX512 static V zero() { return _mm512_setzero_ps(); }
+    NN_TARGET_AVX512 static V set1(float x) { return _mm512_set1_ps(x); }
+    NN_TARGET_AVX512 static V load(const float* p) {
+        return _mm512_loadu_ps(p);
+    }
+    NN_TARGET_AVX512 static void store(float* p, V v) {
+        _mm512_storeu_ps(p, v);
+    }
+    NN_TARGET_AVX512 static V load(M m, const float* p) {
+        return _mm512_maskz_loadu_ps(m, p);
+    }
+    NN_TARGET_AVX512 static void store(float* p, M m, V v) {
+        _mm512_mask_storeu_ps(p, m, v);
+    }
+    template <bool Fused>
+    NN_TARGET_AVX512 static V madd(V a, V b, V acc) {
+        return Fused ? _mm512_fmadd_ps(a, b, acc)
+            : _mm512_add_ps(acc, _mm512_mul_ps(a, b));
+    }
+};
+
+// Mask for the first left lanes of a W-lane register
+template <class S>
+typename S::M lane_mask(int left) {
+    if (left <= 0) return 0;
+    if (left >= S::W) return static_cast<typename S::M>(~0u);
+    return static_cast<typename S::M>((1u << left) - 1);
+}
+
+// 4*W columns held in four registers while the rows stream past
+template <class T, bool Fused, class Rows>
+NN_TARGET_AVX2 void vecmat_rows_avx2(Rows r, int n, int cols, T* c) {
+    typedef Avx2<T> S;
+    const int W = S::W;
+    int col = 0;
+    for (; col + 4*W <= cols; col += 4*W) {
+        typename S::V c0 = S::zero(), c1 = S::zero();
+        typename S::V c2 = S::zero(), c3 = S::zero();
+        for (int k = 0; k < n; k++) {
+            typename S::V ai = S::set1(r.weight(k));
+            const T* b = r.row(k) + col;
+            c0 = S::template madd<Fused>(ai, S::load(b), c0);
+            c1 = S::template madd<Fused>(ai, S::load(b + W), c1);
+            c2 = S::template madd<Fused>(ai, S::load(b + 2*W), c2);
+            c3 = S::template madd<Fused>(ai, S::load(b + 3*W), c3);
+        }
+        S::store(c + col, c0);
+        S::store(c + col + W, c1);
+        S::store(c + col + 2*W, c2);
+        S::store(c + col + 3*W, c3);
+    }
+    for (; col + W <= cols; col += W) {
+        typename S::V c0 = S::zero();
+        for (int k = 0; k < n; k++) {
+            c0 = S::template madd<Fused>(S::set1(r.weight(k)),
+                S::load(r.row(k) + col), c0);
+        }
+        S::store(c + col, c0);
+    }
+    if (col < cols) {
+        vecmat_cols<T>(r, n, cols, c, col);
+    }
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX2 void vecmat_avx2(const T* a, int rows, const T* B, int cols,
+    T* c) {
+    DenseRows<T> r = { a, B, cols };
+    vecmat_rows_avx2<T, Fused>(r, rows, cols, c);
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX2 void sparse_vecmat_avx2(const int* index, const T* value,
+    int n, const T* B, int cols, T* c) {
+    SparseRows<T> r = { index, value, B, cols };
+    vecmat_rows_avx2<T, Fused>(r, n, cols, c);
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX2 void member_vecmat_avx2(const T* a, int rows, const T* B,
+    int cols, int members, T* c) {
+    typedef Avx2<T> S;
+    // accumulators stay in registers across the inputs: W members by up
+    // to 4 columns at a time
+    size_t step = static_cast<size_t>(cols)*members;
+    for (int m = 0; m < members; m += S::W) {
+        int col = 0;
+        for (; col + 4 <= cols; col += 4) {
+            typename S::V acc[4];
+            for (int k = 0; k < 4; k++) acc[k] = S::zero();
+            const T* b = B + col*members + m;
+            for (int inner = 0; inner < rows; inner++, b += step) {
+                typename S::V x = S::load(a + inner*members + m);
+                for (int k = 0; k < 4; k++) {
+                    acc[k] = S::template madd<Fused>(x,
+                        S::load(b + k*members), acc[k]);
+                }
+            }
+            for (int k = 0; k < 4; k++) {
+                S::store(c + (col + k)*members + m, acc[k]);
+            }
+        }
+        for (; col < cols; col++) {
+            typename S::V acc = S::zero();
+            const T* b = B + col*members + m;
+            for (int inner = 0; inner < rows; inner++, b += step) {
+                acc = S::template madd<Fused>(
+                    S::load(a + inner*members + m), S::load(b), acc);
+            }
+            S::store(c + col*members + m, acc);
+        }
+    }
+}
+
+// R rows by 2*W columns of a matmat tile, starting at column col
+template <class T, int R, bool Fused>
+NN_TARGET_AVX2 void block_avx2(const T* A, int K, int kc, const T* B,
+    int N, T* C, int col, bool accumulate) {
+    typedef Avx2<T> S;
+    const int W = S::W;
+    typename S::V lo[R], hi[R];
+    for (int r = 0; r < R; r++) {
+        T* c = C + r*N + col;
+        lo[r] = accumulate ? S::load(c) : S::zero();
+        hi[r] = accumulate ? S::load(c + W) : S::zero();
+    }
+    for (int k = 0; k < kc; k++) {
+        typename S::V b0 = S::load(B + k*N + col);
+        typename S::V b1 = S::load(B + k*N + col + W);
+        for (int r = 0; r < R; r++) {
+            typename S::V a = S::set1(A[r*K + k]);
+            lo[r] = S::template madd<Fused>(a, b0, lo[r]);
+            hi[r] = S::template madd<Fused>(a, b1, hi[r]);
+        }
+    }
+    for (int r = 0; r < R; r++) {
+        S::store(C + r*N + col, lo[r]);
+        S::store(C + r*N + col + W, hi[r]);
+    }
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX2 void tile_avx2(const T* A, int m, int K, int kc, const T* B,
+    int N, T* C, bool accumulate) {
+    const int W = Avx2<T>::W;
+    int col = 0;
+    for (; col + 2*W <= N; col += 2*W) {
+        int r = 0;
+        for (; r + MR <= m; r += MR) {
+            block_avx2<T, MR, Fused>(A + r*K, K, kc, B, N, C + r*N, col,
+                accumulate);
+        }
+        for (; r < m; r++) {
+            block_avx2<T, 1, Fused>(A + r*K, K, kc, B, N, C + r*N, col,
+                accumulate);
+        }
+    }
+    if (col < N) {
+        tile_cols(A, m, K, kc, B, N, C, col, accumulate);
+    }
+}
+
+// 4*W columns in four registers, remainder handled with a masked register
+template <class T, bool Fused, class Rows>
+NN_TARGET_AVX512 void vecmat_rows_avx512(Rows r, int n, int cols, T* c) {
+    typedef Avx512<T> S;
+    const int W = S::W;
+    int col = 0;
+    for (; col + 4*W <= cols; col += 4*W) {
+        typename S::V c0 = S::zero(), c1 = S::zero();
+        typename S::V c2 = S::zero(), c3 = S::zero();
+        for (int k = 0; k < n; k++) {
+            typename S::V ai = S::set1(r.weight(k));
+            const T* b = r.row(k) + col;
+            c0 = S::template madd<Fused>(ai, S::load(b), c0);
+            c1 = S::template madd<Fused>(ai, S::load(b + W), c1);
+            c2 = S::template madd<Fused>(ai, S::load(b + 2*W), c2);
+            c3 = S::template madd<Fused>(ai, S::load(b + 3*W), c3);
+        }
+        S::store(c + col, c0);
+        S::store(c + col + W, c1);
+        S::store(c + col + 2*W, c2);
+        S::store(c + col + 3*W, c3);
+    }
+    for (; col < cols; col += W) {
+        typename S::M m = lane_mask<S>(cols - col);
+        typename S::V c0 = S::zero();
+        for (int k = 0; k < n; k++) {
+            c0 = S::template madd<Fused>(S::set1(r.weight(k)),
+                S::load(m, r.row(k) + col), c0);
+        }
+        S::store(c + col, m, c0);
+    }
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX512 void vecmat_avx512(const T* a, int rows, const T* B,
+    int cols, T* c) {
+    DenseRows<T> r = { a, B, cols };
+    vecmat_rows_avx512<T, Fused>(r, rows, cols, c);
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX512 void sparse_vecmat_avx512(const int* index,
+    const T* value, int n, const T* B, int cols, T* c) {
+    SparseRows<T> r = { index, value, B, cols };
+    vecmat_rows_avx512<T, Fused>(r, n, cols, c);
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX512 void member_vecmat_avx512(const T* a, int rows,
+    const T* B, int cols, int members, T* c) {
+    typedef Avx512<T> S;
+    // accumulators stay in registers across the inputs: W members by up
+    // to 4 columns at a time
+    size_t step = static_cast<size_t>(cols)*members;
+    for (int m = 0; m < members; m += S::W) {
+        int col = 0;
+        for (; col + 4 <= cols; col += 4) {
+            typename S::V acc[4];
+            for (int k = 0; k < 4; k++) acc[k] = S::zero();
+            const T* b = B + col*members + m;
+            for (int inner = 0; inner < rows; inner++, b += step) {
+                typename S::V x = S::load(a + inner*members + m);
+                for (int k = 0; k < 4; k++) {
+                    acc[k] = S::template madd<Fused>(x,
+                        S::load(b + k*members), acc[k]);
+                }
+            }
+            for (int k = 0; k < 4; k++) {
+                S::store(c + (col + k)*members + m, acc[k]);
+            }
+        }
+        for (; col < cols; col++) {
+            typename S::V acc = S::zero();
+            const T* b = B + col*members + m;
+            for (int inner = 0; inner < rows; inner++, b += step) {
+                acc = S::template madd<Fused>(
+                    S::load(a + inner*members + m), S::load(b), acc);
+            }
+            S::store(c + col*members + m, acc);
+        }
+    }
+}
+
+// R rows by 2*W columns of a matmat tile; m0/m1 mask off the right edge
+template <class T, int R, bool Fused>
+NN_TARGET_AVX512 void block_avx512(const T* A, int K, int kc, const T* B,
+    int N, T* C, int col, typename Avx512<T>::M m0,
+    typename Avx512<T>::M m1, bool accumulate) {
+    typedef Avx512<T> S;
+    const int W = S::W;
+    typename S::V lo[R], hi[R];
+    for (int r = 0; r < R; r++) {
+        T* c = C + r*N + col;
+        lo[r] = accumulate ? S::load(m0, c) : S::zero();
+        hi[r] = accumulate ? S::load(m1, c + W) : S::zero();
+    }
+    for (int k = 0; k < kc; k++) {
+        typename S::V b0 = S::load(m0, B + k*N + col);
+        typename S::V b1 = S::load(m1, B + k*N + col + W);
+        for (int r = 0; r < R; r++) {
+            typename S::V a = S::set1(A[r*K + k]);
+            lo[r] = S::template madd<Fused>(a, b0, lo[r]);
+            hi[r] = S::template madd<Fused>(a, b1, hi[r]);
+        }
+    }
+    for (int r = 0; r < R; r++) {
+        S::store(C + r*N + col, m0, lo[r]);
+        S::store(C + r*N + col + W, m1, hi[r]);
+    }
+}
+
+template <class T, bool Fused>
+NN_TARGET_AVX512 void tile_avx512(const T* A, int m, int K, int kc,
+    const T* B, int N, T* C, bool accumulate) {
+    typedef Avx512<T> S;
+    for (int col = 0; col < N; col += 2*S::W) {
+        typename S::M m0 = lane_mask<S>(N - col);
+        typename S::M m1 = lane_mask<S>(N - col - S::W);
+        int r = 0;
+        for (; r + MR <= m; r += MR) {
+            block_avx512<T, MR, Fused>(A + r*K, K, kc, B, N, C + r*N, col,
+                m0, m1, accumulate);
+        }
+        for (; r < m; r++) {
+            block_avx512<T, 1, Fused>(A + r*K, K, kc, B, N, C + r*N, col,
+                m0, m1, accumulate);
+        }
+    }
+}
+
+#if defined(_MSC_VER)
+bool cpu_has(int leaf, int reg, int bit) {
+    int info[4];
+    __cpuidex(info, leaf, 0);
+    return (info[reg] >> bit) & 1;
+}
+#endif
+
+ISA detect() {
+#if defined(_MSC_VER)
+    // OSXSAVE and the OS saving YMM (and ZMM) state are needed as well
+    if (!cpu_has(1, 2, 27)) return SCALAR;
+    unsigned long long xcr0 = _xgetbv(0);
+    bool avx2 = cpu_has(7, 1, 5) && cpu_has(1, 2, 12) && (xcr0 & 0x6) == 0x6;
+    bool avx512 = avx2 && cpu_has(7, 1, 16) && (xcr0 & 0xE6) == 0xE6;
+#else
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2")
+        && __builtin_cpu_supports("fma");
+    bool avx512 = avx2 && __builtin_cpu_supports("avx512f");
+#endif
+    if (avx512) return AVX512;
+    if (avx2) return AVX2;
+    return SCALAR;
+}
+#else
+ISA detect() {
+    return SCALAR;
+}
+#endif
+
+// Selected at static initialization; set_isa/set_mode only reselect.
+// The tables are zero-initialized before any constructor runs, so a null
+// entry means a kernel was called before selection.
+ISA g_detected = detect();
+ISA g_isa = g_detected;
+Kernels<double> g_double_kernels;
+Kernels<float> g_float_kernels;
+
+template <class T> Kernels<T>& kernels();
+template <> Kernels<double>& kernels<double>() { return g_double_kernels; }
+template <> Kernels<float>& kernels<float>() { return g_float_kernels; }
+
+template <class T>
+void select_for(Kernels<T>* k, ISA isa, bool fast) {
+    switch (isa) {
+#ifndef NN_NO_X86
+    case AVX512:
+        k->vecmat = fast ? vecmat_avx512<T, true> : vecmat_avx512<T, false>;
+        k->sparse = fast ? sparse_vecmat_avx512<T, true>
+            : sparse_vecmat_avx512<T, false>;
+        k->tile = fast ? tile_avx512<T, true> : tile_avx512<T, false>;
+        k->member = fast ? member_vecmat_avx512<T, true>
+            : member_vecmat_avx512<T, false>;
+        break;
+    case AVX2:
+        k->vecmat = fast ? vecmat_avx2<T, true> : vecmat_avx2<T, false>;
+        k->sparse = fast ? sparse_vecmat_avx2<T, true>
+            : sparse_vecmat_avx2<T, false>;
+        k->tile = fast ? tile_avx2<T, true> : tile_avx2<T, false>;
+        k->member = fast ? member_vecmat_avx2<T, true>
+            : member_vecmat_avx2<T, false>;
+        break;
+#endif
+    default:
+        k->vecmat = vecmat_scalar<T>;
+        k->sparse = sparse_vecmat_scalar<T>;
+        k->tile = tile_scalar<T>;
+        k->member = member_vecmat_scalar<T>;
+    }
+}
+
+void select_kernels() {
+    bool fast = (g_mode == FAST);
+    select_for(&g_double_kernels, g_isa, fast);
+    select_for(&g_float_kernels, g_isa, fast);
+}
+
+struct KernelSelector {
+    KernelSelector() { select_kernels(); }
+} g_selector;
+
+template <class T>
+void vecmat_any(const T* a, int rows, const T* B, int cols, T* c) {
+    // may be called during static initialization
+    if (!kernels<T>().vecmat) select_kernels();
+    kernels<T>().vecmat(a, rows, B, cols, c);
+}
+
+template <class T>
+void sparse_vecmat_any(const int* index, const T* value, int n, const T* B,
+    int cols, T* c) {
+    if (!kernels<T>().sparse) select_kernels();
+    kernels<T>().sparse(index, value, n, B, cols, c);
+}
+
+template <class T>
+void matmat_any(const T* A, int M, int K, const T* B, int N, T* C) {
+    if (!kernels<T>().tile) select_kernels();
+    if (K == 0) {
+        for (int i = 0; i < M*N; i++) C[i] = 0;
+        return;
+    }
+    // Panels of B are walked in k order, so partial sums carried in C
+    // between panels keep each element's summation order
+    for (int k0 = 0; k0 < K; k0 += KC) {
+        int kc = (K - k0 < KC) ? K - k0 : KC;
+        for (int m0 = 0; m0 < M; m0 += MC) {
+            int mc = (M - m0 < MC) ? M - m0 : MC;
+            kernels<T>().tile(A + m0*K + k0, mc, K, kc, B + k0*N, N,
+                C + m0*N, k0 != 0);
+        }
+    }
+}
+
+template <class T>
+void member_vecmat_any(const T* a, int rows, const T* B, int cols,
+    int members, T* c) {
+    if (!kernels<T>().member) select_kernels();
+    kernels<T>().member(a, rows, B, cols, members, c);
+}
+}  // namespace
+
+ISA detected_isa() {
+    return g_detected;
+}
+
+ISA active_isa() {
+    return g_isa;
+}
+
+void set_isa(ISA isa) {
+    g_isa = (isa > g_detected) ? g_detected : isa;
+    select_kernels();
+}
+
+Mode mode() {
+    return g_mode;
+}
+
+void set_mode(Mode m) {
+    g_mode = m;
+    select_kernels();
+}
+
+const char* isa_name(ISA isa) {
+    static const char* names[NISAS] = { "scalar", "avx2", "avx512" };
+    return names[isa];
+}
+
+void vecmat(const double* a, int rows, const double* B, int cols,
+    double* c) {
+    vecmat_any(a, rows, B, cols, c);
+}
+
+void vecmat(const float* a, int rows, const float* B, int cols, float* c) {
+    vecmat_any(a, rows, B, cols, c);
+}
+
+void sparse_vecmat(const int* index, const double* value, int n,
+    const double* B, int cols, double* c) {
+    sparse_vecmat_any(index, value, n, B, cols, c);
+}
+
+void sparse_vecmat(const int* index, const float* value, int n,
+    const float* B, int cols, float* c) {
+    sparse_vecmat_any(index, value, n, B, cols, c);
+}
+
+void matmat(const double* A, int M, int K, const double* B, int N,
+    double* C) {
+    matmat_any(A, M, K, B, N, C);
+}
+
+void matmat(const float* A, int M, int K, const float* B, int N,
+    float* C) {
+    matmat_any(A, M, K, B, N, C);
+}
+
+void member_vecmat(const double* a, int rows, const double* B, int cols,
+    int members, double* c) {
+    member_vecmat_any(a, rows, B, cols, members, c);
+}
+
+void member_vecmat(const float* a, int rows, const float* B, int cols,
+    int members, float* c) {
+    member_vecmat_any(a, rows, B, cols, members, c);
+}
+}  // namespace nnkernels
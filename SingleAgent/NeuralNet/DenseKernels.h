@@ -0,0 +1,72 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_DENSEKERNELS_H_
+#define SINGLEAGENT_NEURALNET_DENSEKERNELS_H_
+
+/**
+* Vectorized kernels for the dense layers of NeuralNet, in double and float.
+* The instruction set is picked once at startup from the CPU features, with
+* a scalar fallback. Weight blocks are row-major [input][unit], so the
+* kernels vectorize across units: each output still sums its inputs in
+* order, which is what lets STRICT mode match the scalar path bit for bit.
+*/
+
+namespace nnkernels {
+//! Instruction sets the kernels are compiled for, in increasing width
+enum ISA { SCALAR, AVX2, AVX512, NISAS };
+
+//! STRICT keeps separate multiplies and adds (bit-compatible with SCALAR);
+//! FAST allows fused multiply-add where the CPU has it.
+enum Mode { STRICT, FAST };
+
+//! Widest instruction set supported by this CPU and OS
+ISA detected_isa();
+
+//! Instruction set currently used by the kernels
+ISA active_isa();
+
+//! Forces an instruction set (clamped to what the CPU supports)
+void set_isa(ISA isa);
+
+Mode mode();
+void set_mode(Mode m);
+
+const char* isa_name(ISA isa);
+
+//! c[j] = sum_i a[i]*B[i*cols + j] for j < cols, summed in order of i.
+//! Pass a Wbar block with a trailing 1.0 in a to include the bias.
+void vecmat(const double* a, int rows, const double* B, int cols,
+    double* c);
+void vecmat(const float* a, int rows, const float* B, int cols, float* c);
+
+//! vecmat over chosen rows only: c[j] = sum_k value[k]*B[index[k]*cols + j]
+//! for j < cols, summed in order of k. Given the nonzero inputs of a in
+//! increasing order, it matches vecmat on a bit for bit (adding 0*b
+//! changes no sum) at the cost of the nonzeros alone.
+void sparse_vecmat(const int* index, const double* value, int n,
+    const double* B, int cols, double* c);
+void sparse_vecmat(const int* index, const float* value, int n,
+    const float* B, int cols, float* c);
+
+//! C = A*B for row-major A (M x K), B (K x N) and C (M x N). Blocked for
+//! cache and register reuse; each element sums over k in order, so rows of
+//! C match vecmat on the rows of A.
+void matmat(const double* A, int M, int K, const double* B, int N,
+    double* C);
+void matmat(const float* A, int M, int K, const float* B, int N,
+    float* C);
+
+//! Lanes of member-stacked blocks are padded to a multiple of this: one
+//! cache line of T, which is also a whole number of registers
+template <class T>
+int member_lanes() { return static_cast<int>(64 / sizeof(T)); }
+
+//! Stacked vecmat for many networks at once, the member index innermost:
+//! c[j*members + m] = sum_i a[i*members + m]*B[(i*cols + j)*members + m].
+//! members must be a multiple of member_lanes<T>(). Each member's outputs
+//! are summed in the same order as vecmat on that member alone.
+void member_vecmat(const double* a, int rows, const double* B, int cols,
+    int members, double* c);
+void member_vecmat(const float* a, int rows, const float* B, int cols,
+    int members, float* c);
+}  // namespace nnkernels
+#endif  // SINGLEAGENT_NEURALNET_DENSEKERNELS_H_
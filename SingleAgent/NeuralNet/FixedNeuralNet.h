@@ -0,0 +1,230 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_FIXEDNEURALNET_H_
+#define SINGLEAGENT_NEURALNET_FIXEDNEURALNET_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../../Math/Philox.h"
+#include "NeuralNet.h"
+#include "Activation.h"
+
+// layer() is compiled with its callers' flags, and GCC contracts its
+// multiplies and adds into fused multiply-adds wherever FMA is enabled
+// (-march=native), which would break the match with STRICT kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#define FIXEDNN_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define FIXEDNN_NO_CONTRACT
+#endif
+
+/**
+* Single hidden layer network with its shape fixed at compile time, for
+* small policies evaluated very often. Weights live inside the object and
+* activations on the stack, so predict() never touches the heap, and every
+* loop has a constant trip count the compiler can unroll and vectorize.
+*
+* Weights are laid out as in BasicNeuralNet (one row-major Wbar block per
+* interface, bias row last) and saved in the same format, so nets move
+* between the two through save/load. Sums run in the same order as
+* BasicNeuralNet's, so predictions match it exactly in STRICT mode.
+* Mutation and initialization follow BasicNeuralNet as well, which lets
+* BasicNeuroEvo evolve a population of these directly.
+*/
+template <int In, int Hidden, int Out, class Scalar = double>
+class FixedNeuralNet {
+    static_assert(In > 0 && Hidden > 0 && Out > 0,
+        "FixedNeuralNet layers need at least one node");
+
+ public:
+    typedef Scalar scalar_type;
+    typedef typename BasicNeuralNet<Scalar>::WeightView WeightView;
+
+    static const int INPUTS = In;
+    static const int HIDDEN = Hidden;
+    static const int OUTPUTS = Out;
+
+    FixedNeuralNet() : evaluation(0.0), mutationRate(0.5), mutStd(1.0) {
+        setRandomWeights();
+    }
+    //! For code that sizes networks at run time, such as BasicNeuroEvo;
+    //! the sizes must match the template's
+    FixedNeuralNet(int nInput, int nHidden, int nOutput) :
+        evaluation(0.0), mutationRate(0.5), mutStd(1.0) {
+        checkShape(nInput, nHidden, nOutput);
+        setRandomWeights();
+    }
+
+    double evaluation;
+
+    //! o holds In inputs, out gets Out outputs
+    void predict(const Scalar* o, Scalar* out) const {
+        Scalar hidden[Hidden];
+        layer<In, Hidden>(o, w0_, hidden);
+        nnkernels::sigmoid(hidden, Hidden);
+        layer<Hidden, Out>(hidden, w1_, out);
+        nnkernels::sigmoid(out, Out);
+    }
+
+    matrix1d predictContinuous(const matrix1d o) {
+        Scalar in[In];
+        Scalar out[Out];
+        std::copy(o.begin(), o.begin() + In, in);
+        predict(in, out);
+        return matrix1d(out, out + Out);
+    }
+
+    //! Same distribution as BasicNeuralNet::mutate
+    void mutate() { mutate(&rng_); }
+    void mutate(easymath::Philox* rng) {
+        double log_q = easymath::Philox::skipLog(mutationRate);
+        for (int c = 0; c < connections(); c++) {
+            WeightView wbar = Wbar(c);
+            uint64_t n = static_cast<uint64_t>(wbar.size());
+            for (uint64_t k = rng->geometric(log_q); k < n;
+                k += 1 + rng->geometric(log_q)) {
+                wbar.data[k] += static_cast<Scalar>(mutStd*rng->normal());
+            }
+        }
+    }
+    //! Same distribution as BasicNeuralNet::randomize
+    void randomize(easymath::Philox* rng) {
+        for (int c = 0; c < connections(); c++) {
+            WeightView wbar = Wbar(c);
+            double scale = 10.0 / sqrt(static_cast<double>(wbar.rows));
+            for (int k = 0; k < wbar.size(); k++) {
+                wbar.data[k] = static_cast<Scalar>(
+                    scale*(2.0*rng->uniform() - 1));
+            }
+        }
+    }
+
+    const std::vector<int> &nodes() const {
+        static const std::vector<int> n = { In, Hidden, Out };
+        return n;
+    }
+    int connections() const { return 2; }
+
+    //! Hash of the shape and weights: nets that hash alike act alike
+    uint64_t weightHash() const {
+        uint64_t hash = 0;
+        for (int n : nodes()) hash = easymath::hash_combine(hash, n);
+        for (int k = 0; k < W0_SIZE + W1_SIZE; k++) {
+            uint64_t bits = 0;
+            std::memcpy(&bits, k < W0_SIZE ? &w0_[k] : &w1_[k - W0_SIZE],
+                sizeof(Scalar));
+            hash = easymath::hash_combine(hash, bits);
+        }
+        return hash;
+    }
+
+    //! weights with bias for interface c, [input + bias][next unit]
+    WeightView Wbar(int c) {
+        WeightView v;
+        v.data = (c == 0) ? w0_ : w1_;
+        v.rows = (c == 0) ? In + 1 : Hidden + 1;
+        v.cols = (c == 0) ? Hidden : Out;
+        return v;
+    }
+
+    void save(matrix1d *node_info, matrix1d *wt_info) {
+        *node_info = matrix1d(nodes().begin(), nodes().end());
+        wt_info->insert(wt_info->end(), w0_, w0_ + W0_SIZE);
+        wt_info->insert(wt_info->end(), w1_, w1_ + W1_SIZE);
+    }
+
+    void load(matrix1d node_info, matrix1d wt_info) {
+        if (node_info.size() != 3) {
+            printf("FixedNeuralNet: can only load single hidden layer nets.");
+            system("pause");
+            exit(1);
+        }
+        checkShape(static_cast<int>(node_info[0]),
+            static_cast<int>(node_info[1]), static_cast<int>(node_info[2]));
+        std::copy(wt_info.begin(), wt_info.begin() + W0_SIZE, w0_);
+        std::copy(wt_info.begin() + W0_SIZE,
+            wt_info.begin() + W0_SIZE + W1_SIZE, w1_);
+    }
+
+    void save(std::string fileout) {
+        matrix2d outmatrix(2);
+        save(&outmatrix[0], &outmatrix[1]);
+        FileOut::print_vector(outmatrix, fileout);
+    }
+
+    void load(std::string filein) {
+        matrix2d wts = FileIn::read2<double>(filein);
+        load(wts[0], wts[1]);
+    }
+
+    void saveBinary(std::string fileout) {
+        ModelFile::write(fileout, std::vector<FixedNeuralNet*>(1, this));
+    }
+
+    void load(const ModelFile &file, size_t net = 0) {
+        const std::vector<int> &n = file.nodes();
+        if (n.size() != 3) {
+            printf("FixedNeuralNet: can only load single hidden layer nets.");
+            system("pause");
+            exit(1);
+        }
+        checkShape(n[0], n[1], n[2]);
+        file.readBlock(net, 0, w0_);
+        file.readBlock(net, 1, w1_);
+        evaluation = file.evaluation(net);
+    }
+
+ private:
+    static const int W0_SIZE = (In + 1)*Hidden;
+    static const int W1_SIZE = (Hidden + 1)*Out;
+
+    Scalar w0_[W0_SIZE];
+    Scalar w1_[W1_SIZE];
+    double mutationRate;  // probability that each connection is changed
+    double mutStd;  // mutation standard deviation
+    easymath::UniqueStream rng_;
+
+    //! c = a*W + bias, summed in the same order as nnkernels::vecmat
+    template <int Rows, int Cols>
+    FIXEDNN_NO_CONTRACT
+    static void layer(const Scalar* a, const Scalar* W, Scalar* c) {
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+        // local sums, so the compiler knows they alias neither a nor W
+        Scalar sum[Cols] = {};
+        for (int i = 0; i < Rows; i++) {
+            for (int j = 0; j < Cols; j++) {
+                sum[j] += a[i] * W[i*Cols + j];
+            }
+        }
+        for (int j = 0; j < Cols; j++) c[j] = sum[j] + W[Rows*Cols + j];
+    }
+
+    static void checkShape(int nInput, int nHidden, int nOutput) {
+        if (nInput != In || nHidden != Hidden || nOutput != Out) {
+            printf("FixedNeuralNet: shape %i-%i-%i does not match %i-%i-%i.",
+                nInput, nHidden, nOutput, In, Hidden, Out);
+            system("pause");
+            exit(1);
+        }
+    }
+
+    void setRandomWeights() {
+        for (int c = 0; c < connections(); c++) {
+            WeightView wbar = Wbar(c);
+            for (int k = 0; k < wbar.size(); k++) {
+                wbar.data[k] = randSetFanIn(wbar.rows);
+            }
+        }
+    }
+
+    // Same draws as BasicNeuralNet's
+    static double randSetFanIn(double fan_in) {
+        double rand_neg1to1 = easymath::rand(-1, 1)*0.1;
+        double scale_factor = 100.0;
+        return scale_factor*rand_neg1to1 / sqrt(fan_in);
+    }
+};
+#endif  // SINGLEAGENT_NEURALNET_FIXEDNEURALNET_H_
@@ -0,0 +1,32 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_KERNELTARGETS_H_
+#define SINGLEAGENT_NEURALNET_KERNELTARGETS_H_
+
+// Function attributes for the per-ISA kernels. Internal to the kernel
+// translation units; include after the standard headers.
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define NN_TARGET_AVX2
+#define NN_TARGET_AVX512
+#define NN_NOINLINE __declspec(noinline)
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+// GCC would otherwise contract the strict kernels' separate _mm*_mul_pd and
+// _mm*_add_pd into fused multiply-adds
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#define NN_NO_CONTRACT
+#else
+#define NN_NO_CONTRACT optimize("fp-contract=off"),
+#endif
+#define NN_TARGET_AVX2 __attribute__((NN_NO_CONTRACT target("avx2,fma")))
+#define NN_TARGET_AVX512 __attribute__((NN_NO_CONTRACT target("avx512f")))
+#define NN_NOINLINE __attribute__((NN_NO_CONTRACT noinline))
+#else
+#define NN_NO_X86
+#define NN_NOINLINE
+#endif
+
+#endif  // SINGLEAGENT_NEURALNET_KERNELTARGETS_H_
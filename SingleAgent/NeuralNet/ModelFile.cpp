@@ -0,0 +1,143 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "ModelFile.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+const char MAGIC[8] = "NNMODEL";
+const size_t SECTION_ALIGN = easystl::CACHE_LINE;
+static_assert(sizeof(ModelFile::Header) == SECTION_ALIGN,
+    "ModelFile::Header must fill one section");
+
+size_t round_up_section(size_t bytes) {
+    return ((bytes + SECTION_ALIGN - 1) / SECTION_ALIGN)*SECTION_ALIGN;
+}
+
+void write_padding(FILE* out, size_t bytes) {
+    static const char zeros[SECTION_ALIGN] = {};
+    size_t pad = round_up_section(bytes) - bytes;
+    if (pad) fwrite(zeros, 1, pad, out);
+}
+}  // namespace
+
+ModelFile::ModelFile(string filein) : file_(filein), header_(NULL) {
+    if (!file_.data() || file_.size() < sizeof(Header)) {
+        fatal(filein + " is not a model file");
+    }
+
+    header_ = reinterpret_cast<const Header*>(file_.data());
+    if (memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fatal(filein + " is not a model file");
+    }
+    if (header_->version != VERSION) {
+        fatal(filein + " has unsupported model file version "
+            + std::to_string(header_->version));
+    }
+    if (header_->scalar_size != sizeof(float)
+        && header_->scalar_size != sizeof(double)) {
+        fatal(filein + " has an unknown scalar size");
+    }
+
+    if (header_->n_layers < 2 || sizeof(Header)
+        + header_->n_layers*sizeof(int32_t) > file_.size()) {
+        fatal(filein + " is truncated or damaged");
+    }
+    const int32_t* nodes = reinterpret_cast<const int32_t*>(
+        file_.data() + sizeof(Header));
+    nodes_.assign(nodes, nodes + header_->n_layers);
+
+    size_t scalar = header_->scalar_size;
+    size_t net_bytes = 0;
+    for (int c = 0; c < connections(); c++) {
+        block_offsets_.push_back(net_bytes);
+        net_bytes += round_up_section(scalar*(nodes_[c] + 1)*nodes_[c + 1]);
+    }
+    if (net_bytes != header_->net_bytes || header_->weights_offset
+        + header_->n_nets*header_->net_bytes > file_.size()) {
+        fatal(filein + " is truncated or damaged");
+    }
+}
+
+ModelFile::~ModelFile() {}
+
+double ModelFile::evaluation(size_t net) const {
+    const double* evaluations = reinterpret_cast<const double*>(
+        file_.data() + header_->evaluations_offset);
+    return evaluations[net];
+}
+
+const char* ModelFile::netData(size_t net) const {
+    if (net >= size()) fatal("model file member out of range");
+    return file_.data() + header_->weights_offset + net*header_->net_bytes;
+}
+
+template <class Scalar>
+void ModelFile::readBlock(size_t net, int c, Scalar* dst) const {
+    const char* block = netData(net) + block_offsets_[c];
+    size_t n = static_cast<size_t>(nodes_[c] + 1)*nodes_[c + 1];
+    if (header_->scalar_size == sizeof(double)) {
+        const double* src = reinterpret_cast<const double*>(block);
+        std::copy(src, src + n, dst);
+    } else {
+        const float* src = reinterpret_cast<const float*>(block);
+        std::copy(src, src + n, dst);
+    }
+}
+
+template <class Scalar>
+BasicNeuralNetView<Scalar> ModelFile::view(size_t net) const {
+    if (header_->scalar_size != sizeof(Scalar)) {
+        fatal("model file precision does not match the view");
+    }
+    return BasicNeuralNetView<Scalar>(
+        reinterpret_cast<const Scalar*>(netData(net)), nodes_);
+}
+
+void ModelFile::writeHeader(FILE* out, const vector<int> &nodes,
+    size_t scalar_size, const vector<double> &evaluations) {
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.scalar_size = static_cast<uint32_t>(scalar_size);
+    h.n_layers = static_cast<uint32_t>(nodes.size());
+    h.n_nets = evaluations.size();
+    for (size_t c = 0; c + 1 < nodes.size(); c++) {
+        h.net_bytes += round_up_section(
+            scalar_size*(nodes[c] + 1)*nodes[c + 1]);
+    }
+    size_t nodes_bytes = nodes.size()*sizeof(int32_t);
+    size_t evaluations_bytes = evaluations.size()*sizeof(double);
+    h.evaluations_offset = sizeof(Header) + round_up_section(nodes_bytes);
+    h.weights_offset = h.evaluations_offset
+        + round_up_section(evaluations_bytes);
+
+    fwrite(&h, sizeof(h), 1, out);
+    vector<int32_t> nodes32(nodes.begin(), nodes.end());
+    fwrite(nodes32.data(), sizeof(int32_t), nodes32.size(), out);
+    write_padding(out, nodes_bytes);
+    fwrite(evaluations.data(), sizeof(double), evaluations.size(), out);
+    write_padding(out, evaluations_bytes);
+}
+
+void ModelFile::writeBlock(FILE* out, const void* data, size_t bytes) {
+    fwrite(data, 1, bytes, out);
+    write_padding(out, bytes);
+}
+
+void ModelFile::fatal(const string &message) {
+    printf("ModelFile: %s.", message.c_str());
+    system("pause");
+    exit(1);
+}
+
+template void ModelFile::readBlock(size_t, int, double*) const;
+template void ModelFile::readBlock(size_t, int, float*) const;
+template BasicNeuralNetView<double> ModelFile::view(size_t) const;
+template BasicNeuralNetView<float> ModelFile::view(size_t) const;
@@ -0,0 +1,119 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_MODELFILE_H_
+#define SINGLEAGENT_NEURALNET_MODELFILE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../../FileIO/MappedFile.h"
+#include "NeuralNetView.h"
+
+/**
+* Read-only memory mapping of a binary model file: one network or a whole
+* population sharing a topology. Loading copies nothing and parses nothing;
+* view() runs a member straight from the mapping, and NeuralNet::load or
+* BasicNeuroEvo::loadBinary copy members out when they need to train or
+* mutate them.
+*
+* Layout (version 1, native byte order; every section starts on a 64 byte
+* boundary, so each weight block is as aligned as in BasicNeuralNet):
+*   header      Header below
+*   nodes       n_layers int32, inputs first
+*   evaluations n_nets doubles
+*   weights     n_nets blocks of net_bytes, each holding the member's Wbar
+*               blocks (row-major, bias row last) padded to 64 bytes as in
+*               BasicNeuralNet::weights_
+*/
+class ModelFile {
+ public:
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];  // "NNMODEL" and a terminating zero
+        uint32_t version;
+        uint32_t scalar_size;  // sizeof the stored scalar: 4 or 8
+        uint32_t n_layers;
+        uint32_t reserved;
+        uint64_t n_nets;
+        uint64_t net_bytes;
+        uint64_t evaluations_offset;
+        uint64_t weights_offset;
+        char padding[8];
+    };
+
+    explicit ModelFile(std::string filein);
+    ~ModelFile();
+
+    //! number of networks in the file
+    size_t size() const { return static_cast<size_t>(header_->n_nets); }
+    const std::vector<int> &nodes() const { return nodes_; }
+    int connections() const { return static_cast<int>(nodes_.size()) - 1; }
+    size_t scalarSize() const { return header_->scalar_size; }
+    double evaluation(size_t net) const;
+
+    //! Copies interface c of a member into dst, converting to Scalar if the
+    //! file stores the other precision. dst holds (nodes[c] + 1)*nodes[c+1]
+    //! elements, laid out as a Wbar block.
+    template <class Scalar>
+    void readBlock(size_t net, int c, Scalar* dst) const;
+
+    //! Runs member net from the mapping; the file must store Scalar and
+    //! outlive the view
+    template <class Scalar>
+    BasicNeuralNetView<Scalar> view(size_t net) const;
+
+    //! Writes nets (NeuralNet, FloatNeuralNet, FixedNeuralNet or anything
+    //! else with nodes(), Wbar(c), evaluation and scalar_type) to fileout.
+    //! All nets must share a topology.
+    template <class Net>
+    static void write(std::string fileout, const std::vector<Net*> &nets);
+
+ private:
+    ModelFile(const ModelFile &);
+    ModelFile &operator=(const ModelFile &);
+
+    MappedFile file_;
+    const Header* header_;
+    std::vector<int> nodes_;
+    //! byte offset of each interface's block within a member
+    std::vector<size_t> block_offsets_;
+
+    const char* netData(size_t net) const;
+    static void fatal(const std::string &message);
+
+    //! writes the header, topology and evaluations, leaving out at the
+    //! first member's weights
+    static void writeHeader(FILE* out, const std::vector<int> &nodes,
+        size_t scalar_size, const std::vector<double> &evaluations);
+    //! writes one Wbar block, padded with zeros to 64 bytes
+    static void writeBlock(FILE* out, const void* data, size_t bytes);
+};
+
+template <class Net>
+void ModelFile::write(std::string fileout, const std::vector<Net*> &nets) {
+    if (nets.empty()) fatal("no networks to write to " + fileout);
+    std::vector<int> nodes = nets.front()->nodes();
+    std::vector<double> evaluations;
+    for (Net* net : nets) {
+        if (net->nodes() != nodes) {
+            fatal("networks written to " + fileout + " differ in topology");
+        }
+        evaluations.push_back(net->evaluation);
+    }
+
+    FILE* out = fopen(fileout.c_str(), "wb");
+    if (!out) fatal("could not open " + fileout + " for writing");
+    typedef typename Net::scalar_type Scalar;
+    writeHeader(out, nodes, sizeof(Scalar), evaluations);
+    for (Net* net : nets) {
+        for (size_t c = 0; c + 1 < nodes.size(); c++) {
+            int rows = nodes[c] + 1;
+            int cols = nodes[c + 1];
+            writeBlock(out, net->Wbar(static_cast<int>(c)).data,
+                static_cast<size_t>(rows)*cols*sizeof(Scalar));
+        }
+    }
+    if (fclose(out) != 0) fatal("could not finish writing " + fileout);
+}
+#endif  // SINGLEAGENT_NEURALNET_MODELFILE_H_
@@ -1,73 +1,167 @@
 // Copyright 2016 Carrie Rebhuhn
 #include "NeuralNet.h"
+#include "Activation.h"
+#include "DenseKernels.h"
+#include "StreamingDataset.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
 using easymath::rand;
-using easymath::sum;
 using std::vector;
 using std::string;
 
-double NeuralNet::randAddFanIn(double fan_in) {
+namespace {
+//! Blocks each of n threads in wait() until all n have arrived
+class Barrier {
+ public:
+    explicit Barrier(int n) : n_(n), waiting_(0), generation_(0) {}
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int generation = generation_;
+        if (++waiting_ == n_) {
+            waiting_ = 0;
+            generation_++;
+            arrived_.notify_all();
+        } else {
+            arrived_.wait(lock, [&] { return generation != generation_; });
+        }
+    }
+
+ private:
+    std::mutex mutex_;
+    std::condition_variable arrived_;
+    int n_;
+    int waiting_;
+    int generation_;
+};
+}  // namespace
+
+template <class Scalar>
+double BasicNeuralNet<Scalar>::randAddFanIn(double fan_in) {
+    return randAddFanIn(fan_in, &rng_);
+}
+
+template <class Scalar>
+double BasicNeuralNet<Scalar>::randAddFanIn(double fan_in,
+    easymath::Philox* rng) {
     // Adds random amount mutationRate% of the time,
     // amount based on fan_in and mutstd
-    if (rand(0, 1) > mutationRate) {
+    if (rng->uniform() > mutationRate) {
         return 0.0;
     } else {
-        // FOR MUTATION
-        std::default_random_engine generator;
-        generator.seed(static_cast<size_t>(time(NULL)));
-        std::normal_distribution<double> distribution(0.0, mutStd);
-        return distribution(generator);
+        return mutStd*rng->normal();
     }
 }
 
-double NeuralNet::randSetFanIn(double fan_in) {
+template <class Scalar>
+double BasicNeuralNet<Scalar>::randSetFanIn(double fan_in) {
     // For initialization of the neural net weights
     double rand_neg1to1 = rand(-1, 1)*0.1;
     double scale_factor = 100.0;
     return scale_factor*rand_neg1to1 / sqrt(fan_in);
 }
 
-void NeuralNet::mutate() {
-    for (size_t i = 0; i < Wbar.size(); i++) {
-        for (size_t j = 0; j < Wbar[i].size(); j++) {
-            // #pragma parallel omp for
-            for (size_t k = 0; k < Wbar[i][j].size(); k++) {
-                double fan_in = static_cast<double>(Wbar[i].size());
-                Wbar[i][j][k] += randAddFanIn(fan_in);
-            }
+template <class Scalar>
+void BasicNeuralNet<Scalar>::mutate() {
+    mutate(&rng_);
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::mutate(easymath::Philox* rng) {
+    // Each weight changes with probability mutationRate, so the gap from
+    // one changed weight to the next is geometric: jump straight there
+    double log_q = easymath::Philox::skipLog(mutationRate);
+    for (int c = 0; c < connections(); c++) {
+        WeightView wbar = Wbar(c);
+        uint64_t n = static_cast<uint64_t>(wbar.size());
+        for (uint64_t k = rng->geometric(log_q); k < n;
+            k += 1 + rng->geometric(log_q)) {
+            wbar.data[k] += static_cast<Scalar>(mutStd*rng->normal());
         }
     }
 }
 
-void NeuralNet::setRandomWeights() {
-    Wbar = matrix3d(connections());
-    W = matrix3d(connections());
-    for (int c = 0; c < connections(); c++) {  // number of layers
-        int above = c;
-        int below = c + 1;
+template <class Scalar>
+void BasicNeuralNet<Scalar>::randomize(easymath::Philox* rng) {
+    // randSetFanIn's distribution: uniform in +-10/sqrt(fan_in)
+    for (int c = 0; c < connections(); c++) {
+        WeightView wbar = Wbar(c);
+        double scale = 10.0 / sqrt(nodes_[c] + 1.0);
+        for (int k = 0; k < wbar.size(); k++) {
+            wbar.data[k] = static_cast<Scalar>(scale*(2.0*rng->uniform() - 1));
+        }
+    }
+}
+
+template <class Scalar>
+typename BasicNeuralNet<Scalar>::WeightView
+BasicNeuralNet<Scalar>::Wbar(int c) {
+    WeightView v;
+    v.data = &weights_[layer_offsets_[c]];
+    v.rows = nodes_[c] + 1;  // above+1 include bias
+    v.cols = nodes_[c + 1];
+    return v;
+}
+
+template <class Scalar>
+typename BasicNeuralNet<Scalar>::WeightView
+BasicNeuralNet<Scalar>::W(int c) {
+    WeightView v = Wbar(c);
+    v.rows--;  // bias row is stored last, so just stop before it
+    return v;
+}
+
+template <class Scalar>
+uint64_t BasicNeuralNet<Scalar>::weightHash() const {
+    uint64_t hash = 0;
+    for (int n : nodes_) hash = easymath::hash_combine(hash, n);
+    // the padding between blocks stays zero, so it can be hashed too
+    for (size_t i = 0; i < weights_.size(); i++) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &weights_[i], sizeof(Scalar));
+        hash = easymath::hash_combine(hash, bits);
+    }
+    return hash;
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::allocateWeights() {
+    // Lays every interface out back to back, padding so that each block
+    // starts on a cache line
+    layer_offsets_ = vector<size_t>(connections());
+    size_t total = 0;
+    for (int c = 0; c < connections(); c++) {
+        layer_offsets_[c] = total;
+        size_t block = static_cast<size_t>(nodes_[c] + 1)*nodes_[c + 1];
+        total += easystl::round_up_aligned<Scalar>(block);
+    }
+    weights_.assign(total, 0.0);
+}
 
+template <class Scalar>
+void BasicNeuralNet<Scalar>::setRandomWeights() {
+    allocateWeights();
+    for (int c = 0; c < connections(); c++) {  // number of layers
         // Populate Wbar with small random weights, including bias
-        Wbar[c] = (matrix2d(nodes_[above] + 1));
-
-        // above+1 include bias
-        for (int i = 0; i < nodes_[above] + 1; i++) {
-            // reserve memory for the connections below
-            Wbar[c][i] = matrix1d(nodes_[below]);
-            for (int j = 0; j < nodes_[below]; j++) {
-                double fan_in = nodes_[above] + 1.0;
-                Wbar[c][i][j] = randSetFanIn(fan_in);
+        WeightView wbar = Wbar(c);
+        double fan_in = nodes_[c] + 1.0;
+        for (int i = 0; i < wbar.rows; i++) {
+            for (int j = 0; j < wbar.cols; j++) {
+                wbar(i, j) = randSetFanIn(fan_in);
             }
         }
-
-        W[c] = Wbar[c];
-        W[c].pop_back();  // remove extra bias weights
     }
 }
 
-NeuralNet::NeuralNet(int nInputs, int nHidden, int nOutputs, double
-    gamma) :nodes_(vector<int>(3)), gamma_(gamma),
+template <class Scalar>
+BasicNeuralNet<Scalar>::BasicNeuralNet(int nInputs, int nHidden,
+    int nOutputs, double gamma) :nodes_(vector<int>(3)), gamma_(gamma),
     evaluation(0), mutationRate(0.5), mutStd(1.0) {
     nodes_[0] = nInputs;
     nodes_[1] = nHidden;
@@ -75,100 +169,72 @@ NeuralNet::NeuralNet(int nInputs, int nHidden, int nOutputs, double
 
     setRandomWeights();
     setMatrixMultiplicationStorage();
+    sizeWorkspace(&workspace_);
 }
 
-void NeuralNet::load(string filein) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::load(string filein) {
     // loads neural net specs
+    // TOP CONTAINS TOPOLOGY INFORMATION, second row the weights
     matrix2d wts = FileIn::read2<double>(filein);
-
-    // CURRENTLY HARDCODED TO ONLY ALLOW A SINGLE LAYER
-
-    /// TOP CONTAINS TOPOLOGY INFORMATION
-    nodes_ = vector<int>(3);
-    nodes_[0] = static_cast<int>(wts[0][0]);
-    nodes_[1] = static_cast<int>(wts[0][1]);
-    nodes_[2] = static_cast<int>(wts[0][2]);
-
-    Wbar = matrix3d(connections());
-    W = matrix3d(connections());
-    int index = 0;  // index for accessing NN elements
-    for (int c = 0; c < connections(); c++) {  // number of layers
-        int above = c;
-        int below = c + 1;
-
-        // Populate Wbar with loaded weights, including bias
-        Wbar[c] = (matrix2d(nodes_[above] + 1));
-        for (int i = 0; i < nodes_[above] + 1; i++) {
-            // reserve memory for the connections below
-            Wbar[c][i] = matrix1d(nodes_[below]);
-            for (int j = 0; j < nodes_[below]; j++) {
-                Wbar[c][i][j] = wts[1][index++];
-            }
-        }
-
-        W[c] = Wbar[c];
-        W[c].pop_back();  // remove extra bias weights
-    }
-    setMatrixMultiplicationStorage();
+    load(wts[0], wts[1]);
 }
 
-void NeuralNet::save(string fileout) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::save(string fileout) {
     matrix2d outmatrix(2);
-    for (size_t i = 0; i < nodes_.size(); i++) {
-        outmatrix[0].push_back(static_cast<double>(nodes_[i]));
-    }
-
-    for (int c = 0; c < connections(); c++) {
-        int above = c;
-        int below = c + 1;
-
-        for (int i = 0; i < nodes_[above] + 1; i++) {  // above+1 include bias
-            for (int j = 0; j < nodes_[below]; j++) {
-                outmatrix[1].push_back(Wbar[c][i][j]);
-            }
-        }
-    }
+    save(&outmatrix[0], &outmatrix[1]);
     FileOut::print_vector(outmatrix, fileout);
 }
 
-void NeuralNet::load(matrix1d node_info, matrix1d wt_info) {
-    // CURRENTLY HARDCODED TO ONLY ALLOW A SINGLE LAYER
-
+template <class Scalar>
+void BasicNeuralNet<Scalar>::load(matrix1d node_info, matrix1d wt_info) {
     /// TOP CONTAINS TOPOLOGY INFORMATION
-    nodes_ = vector<int>(3);
-    nodes_[0] = static_cast<int>(node_info[0]);
-    nodes_[1] = static_cast<int>(node_info[1]);
-    nodes_[2] = static_cast<int>(node_info[2]);
+    nodes_ = vector<int>(node_info.size());
+    for (size_t i = 0; i < node_info.size(); i++) {
+        nodes_[i] = static_cast<int>(node_info[i]);
+    }
 
-    Wbar = matrix3d(connections());
-    W = matrix3d(connections());
-    int index = 0;  // index for accessing NN elements
+    allocateWeights();
+    matrix1d::const_iterator index = wt_info.begin();
 
     // Connections are number of layers
     for (int c = 0; c < connections(); c++) {
-        int above = c;
-        int below = c + 1;
-
         // Populate Wbar with loaded weights, including bias
-        Wbar[c] = (matrix2d(nodes_[above] + 1));
-        // above+1 include bias;
-        for (int i = 0; i < nodes_[above] + 1; i++) {
-            // reserve memory for the connections below
-            Wbar[c][i] = matrix1d(nodes_[below]);
-            for (int j = 0; j < nodes_[below]; j++) {
-                Wbar[c][i][j] = wt_info[index++];
-            }
-        }
-
-        W[c] = Wbar[c];
-        W[c].pop_back();  // remove extra bias weights
+        WeightView wbar = Wbar(c);
+        std::copy(index, index + wbar.size(), wbar.data);
+        index += wbar.size();
     }
     setMatrixMultiplicationStorage();
+    sizeWorkspace(&workspace_);
 }
 
 
+template <class Scalar>
+void BasicNeuralNet<Scalar>::saveBinary(string fileout) {
+    ModelFile::write(fileout, vector<BasicNeuralNet*>(1, this));
+}
 
-void NeuralNet::save(matrix1d *node_info, matrix1d *wt_info) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::loadBinary(string filein, size_t net) {
+    ModelFile file(filein);
+    load(file, net);
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::load(const ModelFile &file, size_t net) {
+    nodes_ = file.nodes();
+    allocateWeights();
+    for (int c = 0; c < connections(); c++) {
+        file.readBlock(net, c, Wbar(c).data);
+    }
+    evaluation = file.evaluation(net);
+    setMatrixMultiplicationStorage();
+    sizeWorkspace(&workspace_);
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::save(matrix1d *node_info, matrix1d *wt_info) {
     *node_info = matrix1d(nodes_.size());
 
     for (size_t i = 0; i < nodes_.size(); i++) {
@@ -176,98 +242,279 @@ void NeuralNet::save(matrix1d *node_info, matrix1d *wt_info) {
     }
 
     for (int c = 0; c < connections(); c++) {  // number of layers
-        int above = c;
-        int below = c + 1;
-
-        for (int i = 0; i < nodes_[above] + 1; i++) {  // above+1 include bias;
-            for (int j = 0; j < nodes_[below]; j++) {
-                wt_info->push_back(Wbar[c][i][j]);
-            }
-        }
+        // blocks are stored row-major with bias last, same as the file order
+        WeightView wbar = Wbar(c);
+        wt_info->insert(wt_info->end(), wbar.data, wbar.data + wbar.size());
     }
 }
 
-void NeuralNet::setMatrixMultiplicationStorage() {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::setMatrixMultiplicationStorage() {
     // Allocates space for the matrix multiplication storage container,
     // based on current Wbar/connections()
-    matrix_multiplication_storage = matrix2d(connections());
+    matrix_multiplication_storage = vector2(connections());
     for (int connection = 0; connection < connections(); connection++) {
         matrix_multiplication_storage[connection]
-            = matrix1d(Wbar[connection][0].size(), 0.0);
+            = vector1(nodes_[connection + 1], 0.0);
         if (connection + 1 != connections()) {  // if not the output layer
             matrix_multiplication_storage[connection].push_back(1.0);
         }
     }
 }
 
-void NeuralNet::addInputs(int nToAdd) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::sizeWorkspace(Workspace* ws) {
+    // Layer inputs carry a trailing 1.0 for the bias; the output does not
+    int L = connections();
+    ws->outputs = vector2(L + 1);
+    for (int c = 0; c <= L; c++) {
+        ws->outputs[c] = vector1(nodes_[c], 0.0);
+        if (c != L) ws->outputs[c].push_back(1.0);
+    }
+    ws->derivs = vector2(L);
+    ws->deltas = vector2(L);
+    for (int c = 0; c < L; c++) {
+        ws->derivs[c] = vector1(nodes_[c + 1], 0.0);
+        ws->deltas[c] = vector1(nodes_[c + 1], 0.0);
+    }
+    ws->error = vector1(nodes_.back(), 0.0);
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::addInputs(int nToAdd) {
+    // Blocks are resized, so copy the old layout out first
+    WeightStorage old_weights = weights_;
+    vector<size_t> old_offsets = layer_offsets_;
+    int old_inputs = nodes_[0];
+
     nodes_[0] += nToAdd;
+    allocateWeights();
 
-    // add new connections leading to each of the lower nodes
-    for (int i = 0; i < nToAdd; i++) {
-        // adding another connection, each new one leads to nodes below
-        Wbar[0].push_back(matrix1d(nodes_[1], 0.0));
+    for (int c = 0; c < connections(); c++) {
+        const Scalar* old_block = &old_weights[old_offsets[c]];
+        WeightView wbar = Wbar(c);
+        if (c != 0) {
+            std::copy(old_block, old_block + wbar.size(), wbar.data);
+            continue;
+        }
 
-        /*for (int j=0; j<nodes_[1]; j++){
-            double fan_in = nodes_[0]+1.0;
-            double rand_neg1to1 = (double(rand())/double(RAND_MAX))*2.0-1.0;
-            Wbar[0].back()[j]=rand_neg1to1/sqrt(fan_in);
-            Wbar[0].back()[j]=0.0;
-        }*/
+        // new connections leading to each of the lower nodes start at zero,
+        // and are placed ahead of the bias row so that it stays last
+        std::copy(old_block, old_block + old_inputs*wbar.cols, wbar.data);
+        std::copy(old_block + old_inputs*wbar.cols,
+            old_block + (old_inputs + 1)*wbar.cols, wbar.row(wbar.rows - 1));
     }
-    W[0] = Wbar[0];
-    W[0].pop_back();
 
     setMatrixMultiplicationStorage();
+    sizeWorkspace(&workspace_);
 }
 
-NeuralNet::NeuralNet(vector<int> &nodes, double gamma) :
-    evaluation(0.0), nodes_(nodes), gamma_(gamma) {
+template <class Scalar>
+BasicNeuralNet<Scalar>::BasicNeuralNet(vector<int> &nodes, double gamma) :
+    evaluation(0.0), nodes_(nodes), gamma_(gamma), mutationRate(0.5),
+    mutStd(1.0) {
     setRandomWeights();
     setMatrixMultiplicationStorage();
+    sizeWorkspace(&workspace_);
 }
 
-void NeuralNet::train(const matrix2d &observations, const matrix2d &T,
-    double epsilon, int iterations) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::train(const matrix2d &observations,
+    const matrix2d &T, double epsilon, int iterations) {
     // just ensure it's bigger always to begin...
     double err = 2 * epsilon + 1.0;
 
     if (iterations == 0) {
         while (err >= epsilon) {
-            matrix1d errs;
+            err = 0.0;
             for (size_t i = 0; i < observations.size(); i++) {
-                errs.push_back(backProp(observations[i], T[i]));
+                err += backProp(observations[i], T[i]);
             }
-            err = sum(errs);
             printf("Err=%f\n", err);
         }
     } else {
         int step = 0;
 
         while (err >= epsilon && iterations >= step) {
-            matrix1d errs;
+            err = 0.0;
             for (size_t i = 0; i < observations.size(); i++) {
-                errs.push_back(backProp(observations[i], T[i]));
+                err += backProp(observations[i], T[i]);
             }
-            err = sum(errs);
             printf("Err=%f\n", err);
             step++;
         }
     }
 }
 
-matrix1d NeuralNet::predictBinary(matrix1d observations) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::trainMinibatch(const matrix2d &observations,
+    const matrix2d &T, int batch_size, double epsilon, int iterations,
+    int n_threads) {
+    int n = static_cast<int>(observations.size());
+    if (n == 0) return;
+    batch_size = std::max(1, std::min(batch_size, n));
+    for (int i = 0; i < n; i++) {
+        cmp_int_fatal(observations[i].size(), nodes_.front());
+        cmp_int_fatal(T[i].size(), nodes_.back());
+    }
+
+    // batches in order, restarting with each sweep
+    int next = 0;
+    auto next_batch = [&](SampleBatch* batch) {
+        if (next == n) {
+            next = 0;
+            return false;
+        }
+        batch->n = std::min(batch_size, n - next);
+        for (int i = 0; i < batch->n; i++, next++) {
+            batch->inputs[i] = observations[next].data();
+            batch->targets[i] = T[next].data();
+        }
+        return true;
+    };
+    runMinibatches(next_batch, batch_size, epsilon, iterations, n_threads);
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::trainMinibatch(StreamingDataset* data,
+    int batch_size, double epsilon, int iterations, int n_threads) {
+    if (data->size() == 0) return;
+    cmp_int_fatal(data->inputs(), nodes_.front());
+    cmp_int_fatal(data->targets(), nodes_.back());
+    batch_size = std::max(1, batch_size);
+
+    // one shuffled pass over the file per sweep
+    StreamingDataset::Batch streamed;
+    bool in_epoch = false;
+    auto next_batch = [&](SampleBatch* batch) {
+        if (!in_epoch) {
+            data->beginEpoch(batch_size);
+            in_epoch = true;
+        }
+        if (!data->nextBatch(&streamed)) {
+            in_epoch = false;
+            return false;
+        }
+        batch->n = streamed.n;
+        for (int i = 0; i < streamed.n; i++) {
+            batch->inputs[i] = streamed.input(i);
+            batch->targets[i] = streamed.target(i);
+        }
+        return true;
+    };
+    runMinibatches(next_batch, batch_size, epsilon, iterations, n_threads);
+}
+
+template <class Scalar>
+template <class NextBatch>
+void BasicNeuralNet<Scalar>::runMinibatches(NextBatch next_batch,
+    int batch_size, double epsilon, int iterations, int n_threads) {
+    // Batches are cut into fixed slices of GRAIN samples. Each slice sums
+    // into its own gradient, and the slices are then added in order, so
+    // which thread took a slice never changes the sums.
+    const int GRAIN = 16;
+    int max_slices = (batch_size + GRAIN - 1) / GRAIN;
+    if (n_threads <= 0) {
+        n_threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    n_threads = std::max(1, std::min(n_threads, max_slices));
+
+    vector<vector1> slice_grads(max_slices, vector1(weights_.size()));
+    vector1 slice_errs(max_slices);
+    vector<Workspace> workspaces(n_threads);
+    for (Workspace &ws : workspaces) sizeWorkspace(&ws);
+
+    // The batch being worked on, set by this thread between barriers
+    SampleBatch batch;
+    batch.n = 0;
+    batch.inputs.resize(batch_size);
+    batch.targets.resize(batch_size);
+    bool done = false;
+    Barrier start(n_threads);
+    Barrier finish(n_threads);
+
+    auto work = [&](int id) {
+        int slices = (batch.n + GRAIN - 1) / GRAIN;
+        for (int s = id; s < slices; s += n_threads) {
+            vector1 &g = slice_grads[s];
+            std::fill(g.begin(), g.end(), 0.0);
+            double err = 0.0;
+            int last = std::min((s + 1)*GRAIN, batch.n);
+            for (int i = s*GRAIN; i < last; i++) {
+                err += computeDeltas(batch.inputs[i], batch.targets[i],
+                    &workspaces[id]);
+                accumulateGradient(workspaces[id], g.data());
+            }
+            slice_errs[s] = err;
+        }
+    };
+
+    vector<std::thread> workers;
+    for (int id = 1; id < n_threads; id++) {
+        workers.push_back(std::thread([&, id]() {
+            while (true) {
+                start.wait();
+                if (done) return;
+                work(id);
+                finish.wait();
+            }
+        }));
+    }
+
+    // just ensure it's bigger always to begin...
+    double err = 2 * epsilon + 1.0;
+    int step = 0;
+    while (err >= epsilon && (iterations == 0 || iterations >= step)) {
+        std::chrono::steady_clock::time_point t0
+            = std::chrono::steady_clock::now();
+        err = 0.0;
+        size_t samples = 0;
+        while (next_batch(&batch)) {
+            start.wait();
+            work(0);
+            finish.wait();
+
+            int slices = (batch.n + GRAIN - 1) / GRAIN;
+            Scalar rate = static_cast<Scalar>(gamma_ / batch.n);
+            for (size_t k = 0; k < weights_.size(); k++) {
+                Scalar g = 0.0;
+                for (int s = 0; s < slices; s++) g += slice_grads[s][k];
+                weights_[k] -= rate*g;
+            }
+            for (int s = 0; s < slices; s++) err += slice_errs[s];
+            samples += batch.n;
+        }
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+        printf("Err=%f (%.0f samples/s)\n", err,
+            samples / std::max(seconds, 1e-9));
+        step++;
+    }
+
+    done = true;
+    start.wait();
+    for (std::thread &t : workers) t.join();
+}
+
+template <class Scalar>
+matrix1d BasicNeuralNet<Scalar>::predictBinary(matrix1d observations) {
+    vector1 o(observations.begin(), observations.end());
     for (int connection = 0; connection < connections(); connection++) {
-        observations.push_back(1.0);  // add 1 for bias
-        observations = matrixMultiply(observations, Wbar[connection]);
-        sigmoid(&observations);  // Compute outputs
+        o.push_back(1.0);  // add 1 for bias
+        o = matrixMultiply(o, Wbar(connection));
+        sigmoid(&o);  // Compute outputs
     }
-    return observations;
+    return matrix1d(o.begin(), o.end());
 }
 
-matrix1d NeuralNet::predictContinuous(matrix1d observations) {
-    observations.push_back(1.0);
-    matrixMultiply(observations, Wbar[0], &matrix_multiplication_storage[0]);
+template <class Scalar>
+matrix1d BasicNeuralNet<Scalar>::predictContinuous(matrix1d observations) {
+    input_storage_.assign(observations.begin(), observations.end());
+    input_storage_.push_back(1.0);
+    WeightView w0 = Wbar(0);
+    cmp_int_fatal(input_storage_.size(), w0.rows);
+    inputVecmat(input_storage_.data(), w0.rows, w0.data, w0.cols,
+        matrix_multiplication_storage[0].data());
     sigmoid(&matrix_multiplication_storage[0]);
 
     for (int connection = 1; connection < connections(); connection++) {
@@ -276,30 +523,81 @@ matrix1d NeuralNet::predictContinuous(matrix1d observations) {
         matrix_multiplication_storage[connection - 1].back() = 1.0;
 
         matrixMultiply(matrix_multiplication_storage[connection - 1],
-            Wbar[connection], &matrix_multiplication_storage[connection]);
+            Wbar(connection), &matrix_multiplication_storage[connection]);
         sigmoid(&matrix_multiplication_storage[connection]);
     }
 
-    return matrix_multiplication_storage.back();
+    const vector1 &out = matrix_multiplication_storage.back();
+    return matrix1d(out.begin(), out.end());
+}
+
+template <class Scalar>
+matrix2d BasicNeuralNet<Scalar>::batchPredictBinary(
+    const matrix2d &observations) {
+    // predictBinary computes the same sigmoid outputs as predictContinuous
+    return batchPredictContinuous(observations);
 }
 
-matrix2d NeuralNet::batchPredictBinary(const matrix2d &observations) {
-    matrix2d out;
-    for (size_t i = 0; i < observations.size(); i++) {
-        out.push_back(predictBinary(observations[i]));
+template <class Scalar>
+matrix2d BasicNeuralNet<Scalar>::batchPredictContinuous(
+    const matrix2d &observations) {
+    if (observations.empty()) return matrix2d();
+
+    // Pack into one contiguous matrix for the batched products
+    int n = static_cast<int>(observations.size());
+    int n_in = nodes_.front();
+    int n_out = nodes_.back();
+    vector1 O(static_cast<size_t>(n)*n_in);
+    for (int i = 0; i < n; i++) {
+        cmp_int_fatal(observations[i].size(), n_in);
+        std::copy(observations[i].begin(), observations[i].end(),
+            O.begin() + i*n_in);
+    }
+
+    vector1 flat_out(static_cast<size_t>(n)*n_out);
+    batchPredictContinuous(O.data(), n, flat_out.data());
+
+    matrix2d out(n);
+    for (int i = 0; i < n; i++) {
+        out[i].assign(flat_out.begin() + i*n_out,
+            flat_out.begin() + (i + 1)*n_out);
     }
     return out;
 }
 
-matrix2d NeuralNet::batchPredictContinuous(const matrix2d &observations) {
-    matrix2d out;
-    for (size_t i = 0; i < observations.size(); i++) {
-        out.push_back(predictContinuous(observations[i]));
+template <class Scalar>
+void BasicNeuralNet<Scalar>::batchPredictContinuous(const Scalar* O, int n,
+    Scalar* out) {
+    const Scalar* in = O;
+    for (int c = 0; c < connections(); c++) {
+        WeightView w = W(c);
+        const Scalar* bias = Wbar(c).row(w.rows);
+
+        // The last layer writes straight into the caller's output
+        Scalar* layer_out = out;
+        if (c + 1 != connections()) {
+            easystl::aligned_vector<Scalar> &buf = batch_storage_[c % 2];
+            size_t needed = static_cast<size_t>(n)*w.cols;
+            if (buf.size() < needed) buf.resize(needed);
+            layer_out = buf.data();
+        }
+
+        // Bias added after the product, matching the trailing 1.0 input of
+        // the single-observation path
+        nnkernels::matmat(in, n, w.rows, w.data, w.cols, layer_out);
+        for (int i = 0; i < n; i++) {
+            Scalar* row = layer_out + i*w.cols;
+            for (int j = 0; j < w.cols; j++) {
+                row[j] += bias[j];
+            }
+        }
+        nnkernels::sigmoid(layer_out, n*w.cols);
+        in = layer_out;
     }
-    return out;
 }
 
-double NeuralNet::SSE(const matrix1d &myVector) {
+template <class Scalar>
+double BasicNeuralNet<Scalar>::SSE(const vector1 &myVector) {
     double err = 0.0;
     for (size_t i = 0; i < myVector.size(); i++) {
         err += myVector[i] * myVector[i];
@@ -307,183 +605,179 @@ double NeuralNet::SSE(const matrix1d &myVector) {
     return err;
 }
 
-int NeuralNet::connections() {
+template <class Scalar>
+int BasicNeuralNet<Scalar>::connections() {
     return nodes_.size() - 1;
 }
 
-double NeuralNet::backProp(const matrix1d &observations, const matrix1d &t) {
+template <class Scalar>
+double BasicNeuralNet<Scalar>::backProp(const matrix1d &observations,
+    const matrix1d &t) {
     // 'observations' is the input vector, 't' is the 'target vector'
     // returns the SSE for the output vector
+    // Everything lives in workspace_, so no sample allocates.
+    cmp_int_fatal(observations.size(), nodes_.front());
+    double sse = computeDeltas(observations.data(), t.data(), &workspace_);
+
+    // Corrections to weights: Wbar -= gamma*(Ohat[c] outer delta[c])
+    for (int c = 0; c < connections(); c++) {
+        WeightView wbar = Wbar(c);
+        const vector1 &d = workspace_.deltas[c];
+        const vector1 &Ohat = workspace_.outputs[c];
+        for (int i = 0; i < wbar.rows; i++) {
+            Scalar* row = wbar.row(i);
+            Scalar o = Ohat[i];
+            for (int j = 0; j < wbar.cols; j++) {
+                row[j] -= gamma_*(d[j] * o);
+            }
+        }
+    }
+    return sse;
+}
 
-    matrix2d Ohat;  // outputs with bias
-    matrix3d D;  // stored derivatives
+template <class Scalar>
+double BasicNeuralNet<Scalar>::computeDeltas(const double* observations,
+    const double* t, Workspace* ws) {
     // Go through network "feed forward" computation
+    feedForward(observations, ws);
 
-    feedForward(observations, &Ohat, &D);
+    vector2 &Ohat = ws->outputs;
+    vector2 &D = ws->derivs;
+    vector2 &delta = ws->deltas;
 
     // "stored derivatives of the quadratic deviations"
-    matrix1d e(Ohat.back().size() - 1, 0.0);
-
-    for (size_t i = 0; i < Ohat.back().size() - 1; i++) {
+    vector1 &e = ws->error;
+    for (size_t i = 0; i < e.size(); i++) {
         e[i] = (Ohat.back()[i] - t[i]);
     }
 
-    // Hidden/output layer delta calcs
-    matrix2d delta;
-    for (int i = 0; i < connections(); i++) {
-        delta.push_back(matrix1d());
+    // Hidden/output layer delta calcs. D only keeps the diagonal of each
+    // derivative matrix, so multiplying by it is elementwise.
+    for (size_t i = 0; i < e.size(); i++) {
+        delta.back()[i] = D.back()[i] * e[i];  // output layer delta
     }
-    delta.back() = matrixMultiply(D.back(), e);  // output layer delta
 
     // back propagation
     for (int connection = connections() - 2; connection >= 0; connection--) {
-        matrix2d mult = matrixMultiply(D[connection], W[connection + 1]);
-        delta[connection] = matrixMultiply(mult, delta[connection + 1]);
-    }
-
-    // Corrections to weights
-    for (int c = 0; c < connections(); c++) {
-        matrix2d DeltaWbarT =
-            matrixMultiply(delta[c], Ohat[c]);
-        for (size_t i = 0; i < Wbar[c].size(); i++) {
-            for (size_t j = 0; j < Wbar[c][i].size(); j++) {
-                // ji because it's transpose :)
-                Wbar[c][i][j] -= gamma_*DeltaWbarT[j][i];
+        WeightView w = W(connection + 1);
+        const vector1 &next = delta[connection + 1];
+        for (int i = 0; i < w.rows; i++) {
+            const Scalar* row = w.row(i);
+            Scalar d = D[connection][i];
+            Scalar sum = 0.0;
+            for (int j = 0; j < w.cols; j++) {
+                sum += (d*row[j])*next[j];
             }
+            delta[connection][i] = sum;
         }
-
-        W[c] = Wbar[c];
-        W[c].pop_back();
     }
 
     // Calculate SS
     return SSE(e);
 }
 
-void NeuralNet::feedForward(const matrix1d &o, matrix2d *Ohat, matrix3d* D) {
-    Ohat->push_back(o);
-    Ohat->back().push_back(1.0);  // add 1 for bias
-
+template <class Scalar>
+void BasicNeuralNet<Scalar>::accumulateGradient(const Workspace &ws,
+    Scalar* g) {
     for (int c = 0; c < connections(); c++) {
-        Ohat->push_back(matrixMultiply(Ohat->at(c), Wbar[c]));
-        sigmoid(&Ohat->back());
-
-        // D stuff
-        D->push_back(matrix2d());
-
-        // number of hidden/output units, excluding bias
-        int k = Ohat->back().size();
-
-        for (int i = 0; i < k; i++) {  // add for last entry
-            // For last output given, calculate the derivatives
-            double Oi = Ohat->back().at(i);
-            D->at(c).push_back(matrix1d(k, 0.0));
-            D->at(c)[i][i] = Oi*(1 - Oi);  // create a diagonal matrix
-        }
-
-        Ohat->back().push_back(1.0);
-    }
-}
-
-matrix2d NeuralNet::matrixMultiply(const matrix2d &A, const matrix2d &B) {
-    // returns a size(A,1)xsize(B,2) matrix
-    // printf("mm");
-    cmp_int_fatal(A[0].size(), B.size());
-
-    matrix2d C(A.size());
-    for (size_t row = 0; row < A.size(); row++) {
-        C[row] = matrix1d(B[0].size(), 0.0);
-        for (size_t col = 0; col < B[0].size(); col++) {
-            for (size_t inner = 0; inner < B.size(); inner++) {
-                C[row][col] += A[row][inner] * B[inner][col];
+        Scalar* block = g + layer_offsets_[c];
+        int cols = nodes_[c + 1];
+        const vector1 &d = ws.deltas[c];
+        const vector1 &Ohat = ws.outputs[c];
+        for (int i = 0; i <= nodes_[c]; i++) {
+            Scalar* row = block + i*cols;
+            Scalar o = Ohat[i];
+            for (int j = 0; j < cols; j++) {
+                row[j] += d[j] * o;
             }
         }
     }
-
-    return C;
 }
 
-matrix2d NeuralNet::matrixMultiply(const matrix1d &A, const matrix1d &B) {
-    // returns a A.size()xB.size() matrix
+template <class Scalar>
+void BasicNeuralNet<Scalar>::feedForward(const double* o, Workspace* ws) {
+    // Ohat[c] is the input to interface c, with a trailing 1.0 for the bias
+    vector2 &Ohat = ws->outputs;
+    std::copy(o, o + nodes_[0], Ohat[0].begin());
 
-    matrix2d C(A.size());
-    for (size_t row = 0; row < A.size(); row++) {
-        C[row] = matrix1d(B.size(), 0.0);
-        for (size_t col = 0; col < B.size(); col++) {
-            C[row][col] += A[row] * B[col];
-        }
-    }
-
-    return C;
-}
-
-matrix1d NeuralNet::matrixMultiply(const matrix2d &A, const matrix1d &B) {
-    // returns a size(A,1)x1 matrix
-    // assumes B is a COLUMN vector
-    // printf("mm1");
-    cmp_int_fatal(A[0].size(), B.size());
+    for (int c = 0; c < connections(); c++) {
+        matrixMultiply(Ohat[c], Wbar(c), &Ohat[c + 1]);
 
-    matrix1d C(A.size(), 0.0);
-    for (size_t row = 0; row < A.size(); row++) {
-        for (size_t inner = 0; inner < B.size(); inner++) {
-            C[row] += A[row][inner] * B[inner];
-        }
+        // outputs and their derivatives Oi*(1-Oi) in one pass
+        nnkernels::sigmoid_deriv(Ohat[c + 1].data(), ws->derivs[c].data(),
+            nodes_[c + 1]);
     }
-
-    return C;
 }
 
-matrix1d NeuralNet::matrixMultiply(const matrix1d &A, const matrix2d &B) {
+template <class Scalar>
+typename BasicNeuralNet<Scalar>::vector1
+BasicNeuralNet<Scalar>::matrixMultiply(const vector1 &A, const WeightView &B) {
     // Use this if expecting to get a vector back;
     // assumes A is a ROW vector (1xcols)
-    // returns a 1xsize(B,2) matrix
-
-    cmp_int_fatal(A.size(), B.size());
-
-    // MODIFY TO MATCH1
-    matrix1d C(B[0].size(), 0.0);
-    for (size_t col = 0; col < B[0].size(); col++) {
-        for (size_t inner = 0; inner < B.size(); inner++) {
-            C[col] += A[inner] * B[inner][col];
-        }
-    }
+    // returns a 1xB.cols matrix
 
+    vector1 C(B.cols, 0.0);
+    matrixMultiply(A, B, &C);
     return C;
 }
 
-void NeuralNet::matrixMultiply(const matrix1d &A, const matrix2d &B,
-    matrix1d* C) {
-    /* This fills C up to the size of B[0].size().
+template <class Scalar>
+void BasicNeuralNet<Scalar>::matrixMultiply(const vector1 &A,
+    const WeightView &B, vector1* C) {
+    /* This fills C up to B.cols.
     * C is allowed to be larger by 1, to accommodate bias
     * Use this if expecting to get a vector back;
     * assumes A is a ROW vector (1xcols)
-    * returns a 1xsize(B,2) matrix*/
+    * returns a 1xB.cols matrix*/
 
-    cmp_int_fatal(A.size(), B.size());
-    if (B[0].size() != C->size() && B[0].size() != C->size() - 1) {
+    cmp_int_fatal(A.size(), B.rows);
+    int c_size = static_cast<int>(C->size());
+    if (B.cols != c_size && B.cols != c_size - 1) {
         printf("B and C sizes don't match. pausing");
         system("pause");
     }
 
-    // MODIFY TO MATCH1
-    for (size_t col = 0; col < B[0].size(); col++) {
-        C->at(col) = 0.0;
-        for (size_t inner = 0; inner < B.size(); inner++) {
-            C->at(col) += A[inner] * B[inner][col];
+    nnkernels::vecmat(A.data(), B.rows, B.data, B.cols, C->data());
+}
+
+template <class Scalar>
+void BasicNeuralNet<Scalar>::inputVecmat(const Scalar* a, int rows,
+    const Scalar* B, int cols, Scalar* c) {
+    if (sparse_index_.size() < static_cast<size_t>(rows)) {
+        sparse_index_.resize(rows);
+        sparse_value_.resize(rows);
+    }
+    int* index = sparse_index_.data();
+    Scalar* value = sparse_value_.data();
+    // dense as soon as more than 3/4 of the inputs are nonzero
+    int max_sparse = 3*rows/4;
+    int n = 0;
+    for (int i = 0; i < rows; i++) {
+        if (a[i] != 0) {
+            if (n == max_sparse) {
+                nnkernels::vecmat(a, rows, B, cols, c);
+                return;
+            }
+            index[n] = i;
+            value[n++] = a[i];
         }
     }
+    nnkernels::sparse_vecmat(index, value, n, B, cols, c);
 }
 
-void NeuralNet::sigmoid(matrix1d *myVector) {
-    for (size_t i = 0; i < myVector->size(); i++) {
-        myVector->at(i) = 1 / (1 + exp(-myVector->at(i)));
-    }
+template <class Scalar>
+void BasicNeuralNet<Scalar>::sigmoid(vector1 *myVector) {
+    nnkernels::sigmoid(myVector->data(), static_cast<int>(myVector->size()));
 }
 
-void NeuralNet::cmp_int_fatal(int a, int b) {
+template <class Scalar>
+void BasicNeuralNet<Scalar>::cmp_int_fatal(int a, int b) {
     if (a != b) {
         printf("Ints do not match! Pausing to debug then exiting.");
         system("pause");
         exit(1);
     }
 }
+
+template class BasicNeuralNet<double>;
+template class BasicNeuralNet<float>;
@@ -2,53 +2,196 @@
 #ifndef SINGLEAGENT_NEURALNET_NEURALNET_H_
 #define SINGLEAGENT_NEURALNET_NEURALNET_H_
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <chrono>
 #include <random>
 #include <string>
 #include "../../Math/easymath.h"
+#include "../../Math/Philox.h"
+#include "../../STL/AlignedAllocator.h"
 #include "../../FileIO/FileIn.h"
 #include "../../FileIO/FileOut.h"
+#include "ModelFile.h"
 
-class NeuralNet {
+class StreamingDataset;
+
+//! Feed-forward sigmoid network storing its weights and doing its
+//! arithmetic in Scalar (double or float; both are instantiated in
+//! NeuralNet.cpp). Observations, actions and saved weights are always
+//! passed as double, so either precision works with the same callers and
+//! files.
+template <class Scalar>
+class BasicNeuralNet {
  public:
-    NeuralNet() : evaluation(0.0), gamma_(0.9) {}
-    ~NeuralNet() {}
+    typedef Scalar scalar_type;
+    typedef std::vector<Scalar> vector1;
+    typedef std::vector<vector1> vector2;
+    typedef std::vector<vector2> vector3;
+
+    //! Row-major view of one layer's weights. Row i holds the connections
+    //! from input i to every unit in the next layer. In a Wbar view the last
+    //! row holds the bias weights; a W view over the same block stops short
+    //! of it.
+    struct WeightView {
+        Scalar* data;
+        int rows;
+        int cols;
+
+        Scalar& operator()(int i, int j) { return data[i*cols + j]; }
+        Scalar operator()(int i, int j) const { return data[i*cols + j]; }
+        Scalar* row(int i) { return data + i*cols; }
+        const Scalar* row(int i) const { return data + i*cols; }
+        int size() const { return rows*cols; }
+    };
+
+    BasicNeuralNet() : evaluation(0.0), gamma_(0.9), mutStd(1.0),
+        mutationRate(0.5) {}
+    ~BasicNeuralNet() {}
     double evaluation;
+    //! Adds N(0, mutStd) to each weight with probability mutationRate,
+    //! visiting only the weights that change
     void mutate();  // different if child class
+    //! mutate() drawing from rng instead of the net's own stream, so a
+    //! mutation can be replayed from its seed (see SeedGenome)
+    void mutate(easymath::Philox* rng);
+    //! Fresh initial weights drawn from rng, distributed as at construction
+    void randomize(easymath::Philox* rng);
 
     void addInputs(int nToAdd);
 
-    NeuralNet(int nInput, int nHidden, int nOutput, double gamma = 0.9);
-    explicit NeuralNet(std::vector<int> &, double gamma = 0.9);
+    BasicNeuralNet(int nInput, int nHidden, int nOutput, double gamma = 0.9);
+    explicit BasicNeuralNet(std::vector<int> &, double gamma = 0.9);
     void train(const matrix2d &O, const matrix2d &T, double epsilon = 0.0,
         int iterations = 0);
+    //! Minibatch gradient descent: each step moves against the gradient
+    //! averaged over batch_size samples. Slices of each batch are worked on
+    //! by n_threads threads (0 for one per core) and summed in a fixed
+    //! order, so the result does not depend on the thread count. Stops on
+    //! epsilon or iterations like train(), printing the error and the
+    //! samples per second of each sweep.
+    void trainMinibatch(const matrix2d &O, const matrix2d &T, int batch_size,
+        double epsilon = 0.0, int iterations = 0, int n_threads = 0);
+    //! Minibatch training streamed from data, each sweep one shuffled pass
+    //! over the file; otherwise as above
+    void trainMinibatch(StreamingDataset* data, int batch_size,
+        double epsilon = 0.0, int iterations = 0, int n_threads = 0);
     matrix1d predictBinary(const matrix1d o);
     matrix1d predictContinuous(const matrix1d o);
     matrix2d batchPredictBinary(const matrix2d &O);
     matrix2d batchPredictContinuous(const matrix2d &O);
+    //! Runs n observations through the network with one matrix product per
+    //! layer. O holds the observations row by row (n x inputs) and out must
+    //! have room for n x outputs. Intermediate storage is kept between calls.
+    void batchPredictContinuous(const Scalar* O, int n, Scalar* out);
 
     void save(std::string fileout);
     void load(std::string filein);
     void load(matrix1d node_info, matrix1d wt_info);
     void save(matrix1d *node_info, matrix1d *wt_info);
+    //! Binary ModelFile holding just this network, in its own precision
+    void saveBinary(std::string fileout);
+    //! Loads member net of a binary ModelFile, converting precision if the
+    //! file holds the other one
+    void loadBinary(std::string filein, size_t net = 0);
+    void load(const ModelFile &file, size_t net = 0);
+
+    //! number of nodes at each layer, inputs first
+    const std::vector<int> &nodes() const { return nodes_; }
+    int connections();
+
+    //! weights with bias for interface c, [input + bias][next unit]
+    WeightView Wbar(int c);
+    //! weights without bias for interface c (same storage as Wbar)
+    WeightView W(int c);
+
+    //! number of Scalars holding the weights, padding included
+    size_t weightCount() const { return weights_.size(); }
+    //! Hash of the shape and weights: nets that hash alike act alike
+    uint64_t weightHash() const;
+    //! Moves the weights into slot, which holds weightCount() Scalars and
+    //! is owned by the caller (a PopulationArena). They stay there when a
+    //! net of the same shape is assigned to this one, which then only
+    //! copies values; a reshape moves them back to owned memory.
+    void bindWeights(Scalar* slot) { weights_.bind(slot); }
+
+    //! Exits if a size a does not match the b it is meant to have
+    static void cmp_int_fatal(int a, int b);
 
  private:
+    //! Flat weight buffer, owned or bound to caller-owned memory. A copy
+    //! always owns its buffer; assigning a same-sized buffer to a bound one
+    //! copies the values into place instead of reallocating.
+    class WeightStorage {
+     public:
+        WeightStorage() : data_(NULL), size_(0) {}
+        WeightStorage(const WeightStorage &other) :
+            owned_(other.data_, other.data_ + other.size_),
+            data_(owned_.data()), size_(other.size_) {}
+        WeightStorage &operator=(const WeightStorage &other) {
+            if (this == &other) return *this;
+            if (size_ == other.size_) {
+                std::copy(other.data_, other.data_ + size_, data_);
+            } else {
+                owned_.assign(other.data_, other.data_ + other.size_);
+                data_ = owned_.data();
+                size_ = other.size_;
+            }
+            return *this;
+        }
+
+        void assign(size_t n, Scalar value) {
+            if (n != size_) {
+                owned_.resize(n);
+                data_ = owned_.data();
+                size_ = n;
+            }
+            std::fill(data_, data_ + n, value);
+        }
+        void bind(Scalar* slot) {
+            std::copy(data_, data_ + size_, slot);
+            data_ = slot;
+            easystl::aligned_vector<Scalar>().swap(owned_);
+        }
+
+        Scalar &operator[](size_t i) { return data_[i]; }
+        const Scalar &operator[](size_t i) const { return data_[i]; }
+        size_t size() const { return size_; }
+
+     private:
+        easystl::aligned_vector<Scalar> owned_;
+        Scalar* data_;
+        size_t size_;
+    };
+
     double gamma_;
     double mutStd;  // mutation standard deviation
     double mutationRate;  // probability that each connection is changed
+    //! this network's own random stream; copies get a new one
+    easymath::UniqueStream rng_;
 
     //! container for all outputs on way through neural network:
     //! for FAST multiplication
-    matrix2d matrix_multiplication_storage;
+    vector2 matrix_multiplication_storage;
+    //! observation plus bias input, reused between predictions
+    vector1 input_storage_;
+    //! nonzero inputs, gathered by inputVecmat
+    std::vector<int> sparse_index_;
+    vector1 sparse_value_;
+    //! alternating layer outputs for batch prediction, grown as needed
+    easystl::aligned_vector<Scalar> batch_storage_[2];
     //! number of nodes at each layer of the network
     std::vector<int> nodes_;
 
-    //! weights, W[interface][input][hidden(next unit)]. Without bias
-    matrix3d W;
-    //! weights with bias;
-    matrix3d Wbar;
+    //! All weights, one contiguous row-major block per interface with the
+    //! bias row last. Each block starts on a cache line boundary.
+    WeightStorage weights_;
+    //! offset of each interface's block within weights_
+    std::vector<size_t> layer_offsets_;
+
+    //! sizes weights_ and layer_offsets_ for the current nodes_
+    void allocateWeights();
 
     //! sets weights randomly for the defined network
     void setRandomWeights();
@@ -57,26 +200,73 @@ class NeuralNet {
     //! Must be called each time network structure is changed/initiated
     void setMatrixMultiplicationStorage();
 
-    int connections();
+    //! Scratch for one training sample, sized with the network so that
+    //! backProp never allocates. Minibatch workers get one each.
+    struct Workspace {
+        //! input to each interface plus a trailing 1.0 for the bias; the
+        //! last entry is the output layer, without one
+        vector2 outputs;
+        //! sigmoid derivative of each unit: the diagonal of D in the
+        //! textbook formulation, which is all of it that is ever nonzero
+        vector2 derivs;
+        vector2 deltas;
+        vector1 error;
+    };
+    Workspace workspace_;
+
+    //! sizes ws for this network. Must be called on workspace_ each time
+    //! network structure is changed/initiated
+    void sizeWorkspace(Workspace* ws);
+
     double backProp(const matrix1d &o, const matrix1d &t);
-    void feedForward(const matrix1d &o, matrix2d* Ohat, matrix3d* D);
+    //! Runs o forward and t back through the network into ws without
+    //! touching the weights; returns the SSE
+    double computeDeltas(const double* o, const double* t, Workspace* ws);
+    //! fills ws->outputs and ws->derivs for observation o
+    void feedForward(const double* o, Workspace* ws);
+    //! adds the gradient left in ws by computeDeltas to g, laid out as
+    //! weights_
+    void accumulateGradient(const Workspace &ws, Scalar* g);
+
+    //! One minibatch, as pointers to each sample's inputs and targets
+    struct SampleBatch {
+        int n;
+        std::vector<const double*> inputs;
+        std::vector<const double*> targets;
+    };
+    //! Minibatch descent over the batches next_batch(SampleBatch*) hands
+    //! out, at most batch_size samples each; it returns false at the end of
+    //! each sweep
+    template <class NextBatch>
+    void runMinibatches(NextBatch next_batch, int batch_size, double epsilon,
+        int iterations, int n_threads);
 
 
     //! Static functions
-    static double SSE(const matrix1d &myVector);
-    static void matrixMultiply(const matrix1d &A, const matrix2d &B,
-        matrix1d *C);
-    static matrix2d matrixMultiply(const matrix2d &A, const matrix2d &B);
-    static matrix2d matrixMultiply(const matrix1d&A, const matrix1d &B);
-    static matrix1d matrixMultiply(const matrix2d &A, const matrix1d &B);
-    static matrix1d matrixMultiply(const matrix1d &A, const matrix2d &B);
-    static void sigmoid(matrix1d *myVector);
-    static void cmp_int_fatal(int a, int b);
+    static double SSE(const vector1 &myVector);
+    static void matrixMultiply(const vector1 &A, const WeightView &B,
+        vector1 *C);
+    static vector1 matrixMultiply(const vector1 &A, const WeightView &B);
+    static void sigmoid(vector1 *myVector);
 
 
 
  protected:
     double randAddFanIn(double fan_in);
+    //! randAddFanIn drawing from rng instead of the net's own stream
+    double randAddFanIn(double fan_in, easymath::Philox* rng);
     double randSetFanIn(double fan_in);
+
+    //! vecmat for a first layer: a holds rows - 1 inputs and the bias
+    //! input. Observations here are often counts that are mostly zero
+    //! (UAVs per link or direction), so when at most 3/4 of the inputs are
+    //! nonzero only their rows of B are summed, by sparse_vecmat; the
+    //! result is the same either way.
+    void inputVecmat(const Scalar* a, int rows, const Scalar* B, int cols,
+        Scalar* c);
 };
+
+typedef BasicNeuralNet<double> NeuralNet;
+//! Half the memory traffic and twice the SIMD width of NeuralNet
+typedef BasicNeuralNet<float> FloatNeuralNet;
 #endif  // SINGLEAGENT_NEURALNET_NEURALNET_H_
@@ -0,0 +1,77 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_NEURALNETVIEW_H_
+#define SINGLEAGENT_NEURALNET_NEURALNETVIEW_H_
+
+#include <algorithm>
+#include <vector>
+#include "../../STL/AlignedAllocator.h"
+#include "Activation.h"
+#include "DenseKernels.h"
+
+typedef std::vector<double> matrix1d;
+
+/**
+* Inference over weights somebody else owns, such as a memory-mapped
+* ModelFile. Weights are laid out as in BasicNeuralNet::weights_ (one
+* row-major Wbar block per interface, bias row last, each block starting
+* on a cache line) and run through the same kernels, so predictions match
+* the network the weights were saved from.
+*/
+template <class Scalar>
+class BasicNeuralNetView {
+ public:
+    typedef Scalar scalar_type;
+
+    BasicNeuralNetView() : weights_(NULL) {}
+    BasicNeuralNetView(const Scalar* weights, const std::vector<int> &nodes)
+        : weights_(weights), nodes_(nodes) {
+        size_t total = 0;
+        size_t widest = 0;
+        for (int c = 0; c < connections(); c++) {
+            layer_offsets_.push_back(total);
+            size_t block = static_cast<size_t>(nodes_[c] + 1)*nodes_[c + 1];
+            total += easystl::round_up_aligned<Scalar>(block);
+            widest = std::max(widest, static_cast<size_t>(nodes_[c]));
+        }
+        for (int k = 0; k < 2; k++) activations_[k].assign(widest + 1, 1.0);
+    }
+
+    const std::vector<int> &nodes() const { return nodes_; }
+    int connections() const { return static_cast<int>(nodes_.size()) - 1; }
+    //! Wbar block of interface c, [input + bias][next unit]
+    const Scalar* Wbar(int c) const { return weights_ + layer_offsets_[c]; }
+
+    //! o holds nodes().front() inputs, out gets nodes().back() outputs
+    void predict(const Scalar* o, Scalar* out) {
+        Scalar* a = activations_[0].data();
+        std::copy(o, o + nodes_[0], a);
+        for (int c = 0; c < connections(); c++) {
+            int cols = nodes_[c + 1];
+            Scalar* next = (c + 1 == connections()) ? out
+                : activations_[(c + 1) % 2].data();
+            // the trailing 1.0 picks up the bias row
+            a[nodes_[c]] = 1.0;
+            nnkernels::vecmat(a, nodes_[c] + 1, Wbar(c), cols, next);
+            nnkernels::sigmoid(next, cols);
+            a = next;
+        }
+    }
+
+    matrix1d predictContinuous(const matrix1d &o) {
+        std::vector<Scalar> in(o.begin(), o.end());
+        std::vector<Scalar> out(nodes_.back());
+        predict(in.data(), out.data());
+        return matrix1d(out.begin(), out.end());
+    }
+
+ private:
+    const Scalar* weights_;
+    std::vector<int> nodes_;
+    std::vector<size_t> layer_offsets_;
+    //! alternating layer inputs, each with room for the bias input
+    std::vector<Scalar> activations_[2];
+};
+
+typedef BasicNeuralNetView<double> NeuralNetView;
+typedef BasicNeuralNetView<float> FloatNeuralNetView;
+#endif  // SINGLEAGENT_NEURALNET_NEURALNETVIEW_H_
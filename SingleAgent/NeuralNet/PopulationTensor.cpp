@@ -0,0 +1,150 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "PopulationTensor.h"
+#include <algorithm>
+#include <vector>
+#include "Activation.h"
+#include "DenseKernels.h"
+
+using std::vector;
+
+template <class Scalar>
+void BasicPopulationTensor<Scalar>::clear() {
+    nodes_.clear();
+    n_members_ = 0;
+    lanes_ = 0;
+    weights_.clear();
+    layer_offsets_.clear();
+}
+
+template <class Scalar>
+void BasicPopulationTensor<Scalar>::allocate(const vector<int> &nodes,
+    int n_members) {
+    nodes_ = nodes;
+    int L = nnkernels::member_lanes<Scalar>();
+    n_members_ = n_members;
+    lanes_ = ((n_members_ + L - 1) / L)*L;
+
+    layer_offsets_.clear();
+    size_t total = 0;
+    int widest = 0;
+    for (size_t c = 0; c + 1 < nodes_.size(); c++) {
+        layer_offsets_.push_back(total);
+        total += static_cast<size_t>(nodes_[c] + 1)*nodes_[c + 1]*lanes_;
+        widest = std::max(widest, std::max(nodes_[c], nodes_[c + 1]));
+    }
+    weights_.assign(total, 0.0);
+
+    for (int b = 0; b < 2; b++) {
+        storage_[b].assign(static_cast<size_t>(widest + 1)*lanes_, 0.0);
+    }
+}
+
+template <class Scalar>
+const Scalar* BasicPopulationTensor<Scalar>::forward() {
+    for (size_t c = 0; c < layer_offsets_.size(); c++) {
+        int rows = nodes_[c] + 1;
+        int cols = nodes_[c + 1];
+        Scalar* in = storage_[c % 2].data();
+        Scalar* out = storage_[(c + 1) % 2].data();
+
+        // bias row: a trailing input of 1.0 for every member
+        std::fill(in + (rows - 1)*lanes_, in + rows*lanes_, 1.0);
+        nnkernels::member_vecmat(in, rows, weights_.data() + layer_offsets_[c],
+            cols, lanes_, out);
+        if (n_members_ == lanes_) {
+            nnkernels::sigmoid(out, cols*lanes_);
+        } else {
+            // skip the pad lanes: for a few members (the types of a
+            // TypeNeuroEvo) they would be most of the exp calls
+            for (int j = 0; j < cols; j++) {
+                nnkernels::sigmoid(out + j*lanes_, n_members_);
+            }
+        }
+    }
+    return storage_[layer_offsets_.size() % 2].data();
+}
+
+template <class Scalar>
+void BasicPopulationTensor<Scalar>::predict(const Scalar* states,
+    Scalar* out) {
+    int n_in = nodes_.front();
+    int n_out = nodes_.back();
+    Scalar* in = storage_[0].data();
+    for (int m = 0; m < n_members_; m++) {
+        for (int i = 0; i < n_in; i++) {
+            in[i*lanes_ + m] = states[m*n_in + i];
+        }
+    }
+
+    const Scalar* y = forward();
+    for (int m = 0; m < n_members_; m++) {
+        for (int o = 0; o < n_out; o++) {
+            out[m*n_out + o] = y[o*lanes_ + m];
+        }
+    }
+}
+
+template <class Scalar>
+void BasicPopulationTensor<Scalar>::predictAll(const Scalar* states, int n,
+    Scalar* out) {
+    int n_in = nodes_.front();
+    int n_out = nodes_.back();
+    for (int s = 0; s < n; s++) {
+        Scalar* in = storage_[0].data();
+        for (int i = 0; i < n_in; i++) {
+            std::fill(in + i*lanes_, in + (i + 1)*lanes_, states[s*n_in + i]);
+        }
+
+        const Scalar* y = forward();
+        Scalar* dst = out + static_cast<size_t>(s)*n_members_*n_out;
+        for (int m = 0; m < n_members_; m++) {
+            for (int o = 0; o < n_out; o++) {
+                dst[m*n_out + o] = y[o*lanes_ + m];
+            }
+        }
+    }
+}
+
+template <class Scalar>
+matrix2d BasicPopulationTensor<Scalar>::predict(const matrix2d &states) {
+    int n_in = nodes_.front();
+    int n_out = nodes_.back();
+    if (static_cast<int>(states.size()) != n_members_) {
+        printf("PopulationTensor: need one state per member.");
+        system("pause");
+        exit(1);
+    }
+
+    vector<Scalar> packed(static_cast<size_t>(n_members_)*n_in);
+    for (int m = 0; m < n_members_; m++) {
+        BasicNeuralNet<Scalar>::cmp_int_fatal(states[m].size(), n_in);
+        std::copy(states[m].begin(), states[m].begin() + n_in,
+            packed.begin() + m*n_in);
+    }
+    vector<Scalar> flat(static_cast<size_t>(n_members_)*n_out);
+    predict(packed.data(), flat.data());
+
+    matrix2d result(n_members_);
+    for (int m = 0; m < n_members_; m++) {
+        result[m].assign(flat.begin() + m*n_out, flat.begin() + (m + 1)*n_out);
+    }
+    return result;
+}
+
+template <class Scalar>
+matrix2d BasicPopulationTensor<Scalar>::predictAll(const matrix1d &state) {
+    int n_out = nodes_.back();
+    BasicNeuralNet<Scalar>::cmp_int_fatal(state.size(), nodes_.front());
+    vector<Scalar> in(state.begin(), state.end());
+    vector<Scalar> flat(static_cast<size_t>(n_members_)*n_out);
+    predictAll(in.data(), 1, flat.data());
+
+    matrix2d result(n_members_);
+    for (int m = 0; m < n_members_; m++) {
+        result[m].assign(flat.begin() + m*n_out, flat.begin() + (m + 1)*n_out);
+    }
+    return result;
+}
+
+template class BasicPopulationTensor<double>;
+template class BasicPopulationTensor<float>;
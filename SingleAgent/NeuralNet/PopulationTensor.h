@@ -0,0 +1,90 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_POPULATIONTENSOR_H_
+#define SINGLEAGENT_NEURALNET_POPULATIONTENSOR_H_
+
+#include <vector>
+#include "NeuralNet.h"
+
+/**
+* The weights of a whole population of same-shaped networks, stacked so the
+* member index is innermost: element (i, j) of layer c for member m sits at
+* layer_offsets_[c] + (i*cols + j)*lanes_ + m. One forward pass then
+* evaluates every member at once, with the SIMD lanes running over members.
+* Pad lanes past the last member hold zero weights and are never read back.
+*/
+template <class Scalar>
+class BasicPopulationTensor {
+ public:
+    typedef BasicNeuralNet<Scalar> Net;
+
+    BasicPopulationTensor() : n_members_(0), lanes_(0) {}
+
+    //! Copies the weights of the members, which must share one topology.
+    //! Member is any network with nodes() and Wbar(c) in the layout of
+    //! BasicNeuralNet<Scalar>, such as FixedNeuralNet.
+    template <class Member>
+    void pack(const std::vector<Member*> &members);
+    void clear();
+
+    int members() const { return n_members_; }
+    bool empty() const { return n_members_ == 0; }
+    const std::vector<int> &nodes() const { return nodes_; }
+
+    //! One state per member: states is members x inputs, out gets
+    //! members x outputs. Matches predictContinuous on each member.
+    void predict(const Scalar* states, Scalar* out);
+    matrix2d predict(const matrix2d &states);
+
+    //! Every member against each of n states: out gets n x members x outputs
+    void predictAll(const Scalar* states, int n, Scalar* out);
+    //! Every member against one state, [member][output]
+    matrix2d predictAll(const matrix1d &state);
+
+ private:
+    std::vector<int> nodes_;
+    int n_members_;
+    //! members rounded up to nnkernels::member_lanes<Scalar>()
+    int lanes_;
+    easystl::aligned_vector<Scalar> weights_;
+    std::vector<size_t> layer_offsets_;
+    //! [unit + bias][lane] activations, alternating between layers
+    easystl::aligned_vector<Scalar> storage_[2];
+
+    //! Lays out zeroed weights and storage for n_members of this topology
+    void allocate(const std::vector<int> &nodes, int n_members);
+    //! Runs the inputs in storage_[0] through; returns the output layer
+    const Scalar* forward();
+};
+
+template <class Scalar>
+template <class Member>
+void BasicPopulationTensor<Scalar>::pack(
+    const std::vector<Member*> &members) {
+    if (members.empty()) {
+        clear();
+        return;
+    }
+    for (Member* p : members) {
+        if (p->nodes() != members.front()->nodes()) {
+            printf("PopulationTensor: members have different topologies.");
+            system("pause");
+            exit(1);
+        }
+    }
+    allocate(members.front()->nodes(), static_cast<int>(members.size()));
+
+    for (size_t c = 0; c < layer_offsets_.size(); c++) {
+        Scalar* block = weights_.data() + layer_offsets_[c];
+        for (int m = 0; m < n_members_; m++) {
+            typename Member::WeightView w
+                = members[m]->Wbar(static_cast<int>(c));
+            for (int k = 0; k < w.size(); k++) {
+                block[static_cast<size_t>(k)*lanes_ + m] = w.data[k];
+            }
+        }
+    }
+}
+
+typedef BasicPopulationTensor<double> PopulationTensor;
+typedef BasicPopulationTensor<float> FloatPopulationTensor;
+#endif  // SINGLEAGENT_NEURALNET_POPULATIONTENSOR_H_
@@ -0,0 +1,370 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "QuantizedNeuralNet.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "Activation.h"
+#include "DenseKernels.h"
+#include "KernelTargets.h"
+
+using std::vector;
+using nnkernels::Q_ROW_ALIGN;
+
+namespace {
+const int Q_MAX = 127;
+
+// Hidden activations come from a table over [-LUT_RANGE, LUT_RANGE] in
+// steps of 1/LUT_STEPS: a quarter of a 1/127 step at the sigmoid's
+// steepest, and everything past the ends rounds to 0 or 127 anyway.
+const int LUT_RANGE = 8;
+const int LUT_STEPS = 64;
+const int LUT_SIZE = 2 * LUT_RANGE * LUT_STEPS;
+
+struct ActivationTable {
+    // int32 so the vector path can gather from it
+    int32_t q[LUT_SIZE + 1];
+    ActivationTable() {
+        for (int k = 0; k <= LUT_SIZE; k++) {
+            double x = static_cast<double>(k - LUT_SIZE / 2) / LUT_STEPS;
+            q[k] = static_cast<int32_t>(floor(Q_MAX / (1 + exp(-x)) + 0.5));
+        }
+    }
+};
+
+const ActivationTable& table() {
+    static ActivationTable t;
+    return t;
+}
+
+inline int16_t quantize(float x, float inv_scale) {
+    float q = x*inv_scale;
+    q = std::max(-127.0f, std::min(127.0f, q));
+    return static_cast<int16_t>(lrintf(q));
+}
+
+// The scale that maps the largest magnitude in x to Q_MAX
+inline float input_scale(float max_abs) {
+    return max_abs > 0.0f ? max_abs / Q_MAX : 1.0f;
+}
+
+int padded(int rows) {
+    return (rows + Q_ROW_ALIGN - 1) / Q_ROW_ALIGN * Q_ROW_ALIGN;
+}
+
+int even(int rows) { return rows + rows % 2; }
+
+// Element (i, j) of a block in the qvecmat layout
+size_t q_index(int i, int j, int rows, int cols) {
+    int wide = cols & ~7;
+    if (j < wide) return (static_cast<size_t>(i / 2)*wide + j) * 2 + i % 2;
+    return static_cast<size_t>(even(rows))*wide
+        + static_cast<size_t>(j - wide)*padded(rows) + i;
+}
+
+// Size of a block in the qvecmat layout
+size_t q_size(int rows, int cols) {
+    int wide = cols & ~7;
+    return static_cast<size_t>(even(rows))*wide
+        + static_cast<size_t>(cols - wide)*padded(rows);
+}
+
+// Table index of the activation sum*scale + bias, clamped to the table
+inline int lut_index(int32_t sum, float scale, float bias) {
+    float z = sum*scale + bias;
+    z = std::max(-1.0f*LUT_RANGE, std::min(1.0f*LUT_RANGE, z));
+    return static_cast<int>(z*LUT_STEPS + (LUT_SIZE / 2 + 0.5f));
+}
+
+void qvecmat_scalar(const int16_t* a, int rows, const int8_t* B, int cols,
+    int32_t* c) {
+    int wide = cols & ~7;
+    for (int j = 0; j < wide; j++) c[j] = 0;
+    for (int i = 0; i < even(rows); i += 2) {
+        const int8_t* w = B + static_cast<size_t>(i / 2)*wide * 2;
+        for (int j = 0; j < wide; j++) {
+            c[j] += a[i] * w[2 * j] + a[i + 1] * w[2 * j + 1];
+        }
+    }
+    for (int j = wide; j < cols; j++) {
+        const int8_t* w = B + q_index(0, j, rows, cols);
+        int32_t sum = 0;
+        for (int i = 0; i < rows; i++) sum += a[i] * w[i];
+        c[j] = sum;
+    }
+}
+
+float qinput_scalar(const float* x, int n, int16_t* out) {
+    float max_abs = 0.0f;
+    for (int i = 0; i < n; i++) max_abs = std::max(max_abs, fabsf(x[i]));
+    float scale = input_scale(max_abs);
+    for (int i = 0; i < n; i++) out[i] = quantize(x[i], 1.0f / scale);
+    return scale;
+}
+
+void qsigmoid_scalar(const int32_t* sums, float scale, const float* bias,
+    int n, int16_t* out) {
+    const ActivationTable& lut = table();
+    for (int j = 0; j < n; j++) {
+        out[j] = static_cast<int16_t>(lut.q[lut_index(sums[j], scale,
+            bias[j])]);
+    }
+}
+
+#ifndef NN_NO_X86
+// One input pair broadcast against eight units: the pair's int8 weights
+// widen to int16 and _mm256_madd_epi16 adds both products into each int32.
+NN_TARGET_AVX2 inline __m256i qmadd_avx2(__m256i acc, __m256i pair,
+    const int8_t* w) {
+    __m128i w8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+    return _mm256_add_epi32(acc,
+        _mm256_madd_epi16(_mm256_cvtepi8_epi16(w8), pair));
+}
+
+NN_TARGET_AVX2 inline __m256i pair_avx2(const int16_t* a) {
+    int32_t ap;
+    memcpy(&ap, a, sizeof(ap));
+    return _mm256_set1_epi32(ap);
+}
+
+// AVX-512 machines use this too: the 512-bit integer multiply-adds need
+// AVX512BW on top of the AVX512F the dispatcher checks for.
+NN_TARGET_AVX2 void qvecmat_avx2(const int16_t* a, int rows,
+    const int8_t* B, int cols, int32_t* c) {
+    int wide = cols & ~7;
+    int even_rows = even(rows);
+    int j = 0;
+    for (; j + 32 <= wide; j += 32) {
+        __m256i c0 = _mm256_setzero_si256();
+        __m256i c1 = _mm256_setzero_si256();
+        __m256i c2 = _mm256_setzero_si256();
+        __m256i c3 = _mm256_setzero_si256();
+        for (int i = 0; i < even_rows; i += 2) {
+            __m256i pair = pair_avx2(a + i);
+            const int8_t* w = B + (static_cast<size_t>(i / 2)*wide + j) * 2;
+            c0 = qmadd_avx2(c0, pair, w);
+            c1 = qmadd_avx2(c1, pair, w + 16);
+            c2 = qmadd_avx2(c2, pair, w + 32);
+            c3 = qmadd_avx2(c3, pair, w + 48);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + j), c0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + j + 8), c1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + j + 16), c2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + j + 24), c3);
+    }
+    for (; j < wide; j += 8) {
+        __m256i c0 = _mm256_setzero_si256();
+        for (int i = 0; i < even_rows; i += 2) {
+            c0 = qmadd_avx2(c0, pair_avx2(a + i),
+                B + (static_cast<size_t>(i / 2)*wide + j) * 2);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + j), c0);
+    }
+    // narrow remainder: a dot product down each contiguous column
+    const int8_t* tail = B + static_cast<size_t>(even_rows)*wide;
+    for (; j < cols; j++) {
+        const int8_t* w = tail + static_cast<size_t>(j - wide)*padded(rows);
+        __m256i acc = _mm256_setzero_si256();
+        for (int i = 0; i < rows; i += 16) {
+            __m128i w8 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(w + i));
+            __m256i x = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(a + i));
+            acc = _mm256_add_epi32(acc,
+                _mm256_madd_epi16(_mm256_cvtepi8_epi16(w8), x));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc),
+            _mm256_extracti128_si256(acc, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        c[j] = _mm_cvtsi128_si32(s);
+    }
+}
+
+// cvtps rounds to nearest even, as lrintf does in the default mode
+NN_TARGET_AVX2 float qinput_avx2(const float* x, int n, int16_t* out) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 vmax = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        vmax = _mm256_max_ps(vmax,
+            _mm256_and_ps(abs_mask, _mm256_loadu_ps(x + i)));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vmax);
+    float max_abs = 0.0f;
+    for (int k = 0; k < 8; k++) max_abs = std::max(max_abs, lanes[k]);
+    for (int k = i; k < n; k++) max_abs = std::max(max_abs, fabsf(x[k]));
+    float scale = input_scale(max_abs);
+
+    const __m256 inv = _mm256_set1_ps(1.0f / scale);
+    const __m256 lo = _mm256_set1_ps(-1.0f*Q_MAX);
+    const __m256 hi = _mm256_set1_ps(1.0f*Q_MAX);
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256 q = _mm256_mul_ps(_mm256_loadu_ps(x + i), inv);
+        __m256i q32 = _mm256_cvtps_epi32(
+            _mm256_max_ps(lo, _mm256_min_ps(hi, q)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+            _mm_packs_epi32(_mm256_castsi256_si128(q32),
+                _mm256_extracti128_si256(q32, 1)));
+    }
+    for (; i < n; i++) out[i] = quantize(x[i], 1.0f / scale);
+    return scale;
+}
+
+// Same separate multiply and add as lut_index, eight units at a time
+NN_TARGET_AVX2 void qsigmoid_avx2(const int32_t* sums, float scale,
+    const float* bias, int n, int16_t* out) {
+    const ActivationTable& lut = table();
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 lo = _mm256_set1_ps(-1.0f*LUT_RANGE);
+    const __m256 hi = _mm256_set1_ps(1.0f*LUT_RANGE);
+    const __m256 steps = _mm256_set1_ps(1.0f*LUT_STEPS);
+    const __m256 mid = _mm256_set1_ps(LUT_SIZE / 2 + 0.5f);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 z = _mm256_cvtepi32_ps(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(sums + j)));
+        z = _mm256_add_ps(_mm256_mul_ps(z, vscale),
+            _mm256_loadu_ps(bias + j));
+        z = _mm256_max_ps(lo, _mm256_min_ps(hi, z));
+        __m256i k = _mm256_cvttps_epi32(
+            _mm256_add_ps(_mm256_mul_ps(z, steps), mid));
+        __m256i q = _mm256_i32gather_epi32(lut.q, k, 4);
+        __m128i q16 = _mm_packs_epi32(_mm256_castsi256_si128(q),
+            _mm256_extracti128_si256(q, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), q16);
+    }
+    qsigmoid_scalar(sums + j, scale, bias + j, n - j, out + j);
+}
+#endif
+
+// Observation to int8 range by its own scale, so no input saturates;
+// returns the scale
+float qinput(const float* x, int n, int16_t* out) {
+#ifndef NN_NO_X86
+    if (nnkernels::active_isa() != nnkernels::SCALAR) {
+        return qinput_avx2(x, n, out);
+    }
+#endif
+    return qinput_scalar(x, n, out);
+}
+
+// Hidden layer output: activations rounded to 1/127 steps
+void qsigmoid(const int32_t* sums, float scale, const float* bias, int n,
+    int16_t* out) {
+#ifndef NN_NO_X86
+    if (nnkernels::active_isa() != nnkernels::SCALAR) {
+        qsigmoid_avx2(sums, scale, bias, n, out);
+        return;
+    }
+#endif
+    qsigmoid_scalar(sums, scale, bias, n, out);
+}
+}  // namespace
+
+namespace nnkernels {
+void qvecmat(const int16_t* a, int rows, const int8_t* B, int cols,
+    int32_t* c) {
+#ifndef NN_NO_X86
+    if (active_isa() != SCALAR) {
+        qvecmat_avx2(a, rows, B, cols, c);
+        return;
+    }
+#endif
+    qvecmat_scalar(a, rows, B, cols, c);
+}
+}  // namespace nnkernels
+
+void QuantizedNeuralNet::allocate(const vector<int> &nodes) {
+    nodes_ = nodes;
+    layer_offsets_.clear();
+    bias_offsets_.clear();
+    scales_.assign(nodes_.size() - 1, 1.0f);
+    size_t total = 0;
+    size_t n_biases = 0;
+    int widest = 0;
+    for (size_t c = 0; c + 1 < nodes_.size(); c++) {
+        layer_offsets_.push_back(total);
+        bias_offsets_.push_back(n_biases);
+        // keep each block on a cache line boundary
+        total += q_size(nodes_[c], nodes_[c + 1]);
+        total = (total + 63) / 64 * 64;
+        n_biases += nodes_[c + 1];
+        widest = std::max(widest, std::max(nodes_[c], nodes_[c + 1]));
+    }
+    weights_.assign(total, 0);
+    biases_.resize(n_biases);
+
+    activations_.assign(padded(widest), 0);
+    sums_.resize(widest);
+    input_storage_.resize(nodes_.front());
+    output_storage_.resize(nodes_.back());
+}
+
+template <class Scalar>
+void QuantizedNeuralNet::setLayer(int c, const Scalar* wbar) {
+    int rows = nodes_[c];
+    int cols = nodes_[c + 1];
+
+    double max_abs = 0.0;
+    for (int k = 0; k < rows*cols; k++) {
+        max_abs = std::max(max_abs, fabs(static_cast<double>(wbar[k])));
+    }
+    float scale = max_abs > 0.0 ? static_cast<float>(max_abs / Q_MAX) : 1.0f;
+    scales_[c] = scale;
+
+    int8_t* block = weights_.data() + layer_offsets_[c];
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            block[q_index(i, j, rows, cols)] = static_cast<int8_t>(quantize(
+                static_cast<float>(wbar[i*cols + j]), 1.0f / scale));
+        }
+    }
+    // the bias row is last
+    for (int j = 0; j < cols; j++) {
+        biases_[bias_offsets_[c] + j] = static_cast<float>(wbar[rows*cols + j]);
+    }
+}
+
+void QuantizedNeuralNet::predict(const float* o, float* out) {
+    float in_scale = qinput(o, nodes_.front(), activations_.data());
+
+    size_t n_layers = layer_offsets_.size();
+    for (size_t c = 0; c < n_layers; c++) {
+        int rows = nodes_[c];
+        int cols = nodes_[c + 1];
+        // zero the padding, which may hold a wider layer's activations
+        std::fill(activations_.begin() + rows,
+            activations_.begin() + padded(rows), 0);
+        nnkernels::qvecmat(activations_.data(), rows,
+            weights_.data() + layer_offsets_[c], cols, sums_.data());
+
+        float scale = in_scale*scales_[c];
+        const float* bias = biases_.data() + bias_offsets_[c];
+        if (c + 1 < n_layers) {
+            qsigmoid(sums_.data(), scale, bias, cols, activations_.data());
+            in_scale = 1.0f / Q_MAX;
+        } else {
+            for (int j = 0; j < cols; j++) out[j] = sums_[j] * scale + bias[j];
+            nnkernels::sigmoid(out, cols);
+        }
+    }
+}
+
+matrix1d QuantizedNeuralNet::predictContinuous(const matrix1d &o) {
+    std::copy(o.begin(), o.begin() + nodes_.front(), input_storage_.begin());
+    predict(input_storage_.data(), output_storage_.data());
+    return matrix1d(output_storage_.begin(), output_storage_.end());
+}
+
+matrix2d QuantizedNeuralNet::batchPredictContinuous(const matrix2d &O) {
+    matrix2d out(O.size());
+    for (size_t i = 0; i < O.size(); i++) {
+        out[i] = predictContinuous(O[i]);
+    }
+    return out;
+}
+
+template void QuantizedNeuralNet::setLayer(int, const double*);
+template void QuantizedNeuralNet::setLayer(int, const float*);
@@ -0,0 +1,105 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_QUANTIZEDNEURALNET_H_
+#define SINGLEAGENT_NEURALNET_QUANTIZEDNEURALNET_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "NeuralNet.h"
+
+/**
+* Frozen int8 copy of a trained network, for evaluation-only runs where the
+* weights never change. Each layer keeps its weights as int8 with one scale
+* for the layer and its biases in float. Layer inputs are int8 too: the
+* observation is scaled by its largest magnitude, hidden activations are
+* rounded to 1/127 steps through a lookup table. Products accumulate in
+* int32, so every instruction set gives the same answer. Only the output
+* layer evaluates the sigmoid, with nnkernels::accuracy().
+*/
+class QuantizedNeuralNet {
+ public:
+    QuantizedNeuralNet() {}
+    //! Net is any network with nodes() and Wbar(c) in the layout of
+    //! BasicNeuralNet, in double or float
+    template <class Net>
+    explicit QuantizedNeuralNet(Net &net) {
+        allocate(net.nodes());
+        for (size_t c = 0; c + 1 < nodes_.size(); c++) {
+            setLayer(static_cast<int>(c), net.Wbar(static_cast<int>(c)).data);
+        }
+    }
+
+    matrix1d predictContinuous(const matrix1d &o);
+    matrix2d batchPredictContinuous(const matrix2d &O);
+    //! o holds the inputs, out gets the outputs
+    void predict(const float* o, float* out);
+
+    const std::vector<int> &nodes() const { return nodes_; }
+    //! per-layer weight scale: int8 weight w stands for w*scale(c)
+    float scale(int c) const { return scales_[c]; }
+
+    //! How far the quantized outputs are from the source network's
+    struct Drift {
+        double max_abs;
+        double mean_abs;
+    };
+    //! Drift against net over the observations O; net should be the network
+    //! this copy was made from
+    template <class Net>
+    Drift drift(Net &net, const matrix2d &O) {
+        Drift d = { 0.0, 0.0 };
+        size_t n = 0;
+        for (const matrix1d &o : O) {
+            matrix1d exact = net.predictContinuous(o);
+            matrix1d approx = predictContinuous(o);
+            for (size_t j = 0; j < exact.size(); j++) {
+                double err = fabs(approx[j] - exact[j]);
+                d.max_abs = std::max(d.max_abs, err);
+                d.mean_abs += err;
+                n++;
+            }
+        }
+        if (n > 0) d.mean_abs /= n;
+        return d;
+    }
+
+ private:
+    std::vector<int> nodes_;
+    //! int8 weights of each interface without the bias row, in the layout
+    //! nnkernels::qvecmat takes
+    easystl::aligned_vector<int8_t> weights_;
+    std::vector<size_t> layer_offsets_;
+    std::vector<float> scales_;
+    //! float biases of each interface, back to back
+    std::vector<float> biases_;
+    std::vector<size_t> bias_offsets_;
+
+    //! layer inputs held as int16 for the multiply-adds, padded with zeros
+    std::vector<int16_t> activations_;
+    std::vector<int32_t> sums_;
+    std::vector<float> input_storage_;
+    std::vector<float> output_storage_;
+
+    //! sizes every block for the topology nodes
+    void allocate(const std::vector<int> &nodes);
+    //! quantizes interface c from its Wbar block (bias row last)
+    template <class Scalar>
+    void setLayer(int c, const Scalar* wbar);
+};
+
+namespace nnkernels {
+//! Inputs of an int8 layer are padded with zeros to a multiple of this
+const int Q_ROW_ALIGN = 16;
+
+//! Int8 layer product with int32 sums: c[j] = sum_i a[i]*B(i, j). a holds
+//! int8-range values, zero padded up to a multiple of Q_ROW_ALIGN. With
+//! wide = cols rounded down to a multiple of 8, even = rows rounded up to
+//! even and padded = rows rounded up to Q_ROW_ALIGN, B(i, j) is at
+//! ((i/2)*wide + j)*2 + i%2 for j < wide (input pairs side by side, so one
+//! multiply-add covers eight units) and at even*wide + (j - wide)*padded + i
+//! for the remaining columns (one zero padded column each).
+void qvecmat(const int16_t* a, int rows, const int8_t* B, int cols,
+    int32_t* c);
+}  // namespace nnkernels
+#endif  // SINGLEAGENT_NEURALNET_QUANTIZEDNEURALNET_H_
@@ -0,0 +1,236 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "StreamingDataset.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "../../Math/Philox.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+const char MAGIC[8] = "NNDATA";
+static_assert(sizeof(StreamingDataset::Header) == 64,
+    "StreamingDataset::Header must be 64 bytes");
+
+//! Fisher-Yates, spelled out so that a seed gives the same order with
+//! every standard library
+void shuffle(vector<size_t>* v, easymath::Philox* rng) {
+    for (size_t i = v->size(); i > 1; i--) {
+        std::swap((*v)[i - 1], (*v)[rng->word() % i]);
+    }
+}
+
+//! fseek past 2GB
+int seek(FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET);
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+}  // namespace
+
+StreamingDataset::StreamingDataset(string filein, int prefetch_batches,
+    unsigned seed) : file_(filein), header_(NULL), records_(NULL),
+    seed_(seed), epoch_(0), batch_size_(0), n_batches_(0), consumed_(0),
+    slots_(std::max(1, prefetch_batches)), head_(0), filled_(0),
+    stop_(false) {
+    if (!file_.data() || file_.size() < sizeof(Header)) {
+        fatal(filein + " is not a dataset file");
+    }
+    header_ = reinterpret_cast<const Header*>(file_.data());
+    if (memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fatal(filein + " is not a dataset file");
+    }
+    if (header_->version != VERSION) {
+        fatal(filein + " has unsupported dataset version "
+            + std::to_string(header_->version));
+    }
+    size_t stride = header_->n_inputs + header_->n_targets;
+    if (sizeof(Header) + size()*stride*sizeof(double) > file_.size()) {
+        fatal(filein + " is truncated");
+    }
+    records_ = reinterpret_cast<const double*>(file_.data() + sizeof(Header));
+}
+
+StreamingDataset::~StreamingDataset() {
+    stopPrefetch();
+}
+
+void StreamingDataset::beginEpoch(int batch_size) {
+    stopPrefetch();
+    batch_size_ = std::max(1, batch_size);
+    n_batches_ = (size() + batch_size_ - 1) / batch_size_;
+    consumed_ = 0;
+    head_ = 0;
+    filled_ = 0;
+    stop_ = false;
+    prefetcher_ = std::thread(&StreamingDataset::prefetch, this,
+        seed_ + epoch_++);
+}
+
+bool StreamingDataset::nextBatch(Batch* b) {
+    if (consumed_ == n_batches_) {
+        stopPrefetch();
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return filled_ > 0; });
+    Batch &slot = slots_[head_];
+    std::swap(b->records, slot.records);
+    b->n = slot.n;
+    b->n_inputs = slot.n_inputs;
+    b->stride = slot.stride;
+    head_ = (head_ + 1) % slots_.size();
+    filled_--;
+    consumed_++;
+    changed_.notify_all();
+    return true;
+}
+
+void StreamingDataset::prefetch(unsigned seed) {
+    int stride = inputs() + targets();
+    size_t n_chunks = (size() + CHUNK - 1) / CHUNK;
+    easymath::Philox rng(seed, 0);
+    vector<size_t> chunks(n_chunks);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    shuffle(&chunks, &rng);
+
+    vector<size_t> order;
+    Batch* slot = NULL;
+    for (size_t k = 0; k < n_chunks; k++) {
+        size_t first = chunks[k]*CHUNK;
+        size_t last = std::min(first + CHUNK, size());
+        if (k + 1 < n_chunks) {
+            size_t next = chunks[k + 1]*CHUNK;
+            size_t n = std::min(CHUNK, size() - next);
+            file_.willNeed(sizeof(Header) + next*stride*sizeof(double),
+                n*stride*sizeof(double));
+        }
+        order.resize(last - first);
+        std::iota(order.begin(), order.end(), first);
+        shuffle(&order, &rng);
+
+        for (size_t r : order) {
+            if (!slot) {
+                slot = acquireSlot();
+                if (!slot) return;
+            }
+            const double* record = records_ + r*stride;
+            std::copy(record, record + stride,
+                slot->records.begin() + slot->n*stride);
+            if (++slot->n == batch_size_) {
+                publishSlot();
+                slot = NULL;
+            }
+        }
+    }
+    if (slot) publishSlot();
+}
+
+StreamingDataset::Batch* StreamingDataset::acquireSlot() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] {
+        return stop_ || filled_ < slots_.size();
+    });
+    if (stop_) return NULL;
+    Batch* slot = &slots_[(head_ + filled_) % slots_.size()];
+    lock.unlock();
+
+    slot->n = 0;
+    slot->n_inputs = inputs();
+    slot->stride = inputs() + targets();
+    slot->records.resize(static_cast<size_t>(batch_size_)*slot->stride);
+    return slot;
+}
+
+void StreamingDataset::publishSlot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    filled_++;
+    changed_.notify_all();
+}
+
+void StreamingDataset::stopPrefetch() {
+    if (!prefetcher_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        changed_.notify_all();
+    }
+    prefetcher_.join();
+}
+
+void StreamingDataset::fatal(const string &message) {
+    printf("StreamingDataset: %s.", message.c_str());
+    system("pause");
+    exit(1);
+}
+
+DatasetWriter::DatasetWriter(string fileout, int n_inputs, int n_targets,
+    bool append) : out_(NULL), n_inputs_(n_inputs), n_targets_(n_targets),
+    n_records_(0) {
+    StreamingDataset::Header h;
+    if (append) {
+        out_ = fopen(fileout.c_str(), "r+b");
+        if (out_ && fread(&h, sizeof(h), 1, out_) == 1) {
+            if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0
+                || h.n_inputs != static_cast<uint32_t>(n_inputs)
+                || h.n_targets != static_cast<uint32_t>(n_targets)) {
+                printf("DatasetWriter: %s holds other records.",
+                    fileout.c_str());
+                system("pause");
+                exit(1);
+            }
+            n_records_ = static_cast<size_t>(h.n_records);
+            // carry on after the last counted record
+            seek(out_, sizeof(h) + static_cast<uint64_t>(n_records_)
+                *(n_inputs + n_targets)*sizeof(double));
+            return;
+        }
+        if (out_) fclose(out_);
+    }
+
+    out_ = fopen(fileout.c_str(), "w+b");
+    if (!out_) {
+        printf("DatasetWriter: could not open %s.", fileout.c_str());
+        system("pause");
+        exit(1);
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = StreamingDataset::VERSION;
+    h.n_inputs = static_cast<uint32_t>(n_inputs);
+    h.n_targets = static_cast<uint32_t>(n_targets);
+    fwrite(&h, sizeof(h), 1, out_);
+}
+
+void DatasetWriter::append(const double* o, const double* t) {
+    fwrite(o, sizeof(double), n_inputs_, out_);
+    fwrite(t, sizeof(double), n_targets_, out_);
+    n_records_++;
+}
+
+void DatasetWriter::append(const matrix1d &o, const matrix1d &t) {
+    if (static_cast<int>(o.size()) != n_inputs_
+        || static_cast<int>(t.size()) != n_targets_) {
+        printf("DatasetWriter: record does not match the file's width.");
+        system("pause");
+        exit(1);
+    }
+    append(o.data(), t.data());
+}
+
+void DatasetWriter::close() {
+    if (!out_) return;
+    // the count goes in last, so a file cut short still reads as valid
+    uint64_t n = n_records_;
+    seek(out_, offsetof(StreamingDataset::Header, n_records));
+    fwrite(&n, sizeof(n), 1, out_);
+    fclose(out_);
+    out_ = NULL;
+}
@@ -0,0 +1,131 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEURALNET_STREAMINGDATASET_H_
+#define SINGLEAGENT_NEURALNET_STREAMINGDATASET_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../FileIO/MappedFile.h"
+
+typedef std::vector<double> matrix1d;
+
+/**
+* Training samples streamed from a memory-mapped binary file, for datasets
+* larger than memory. Records are fixed width: the inputs followed by the
+* targets, as doubles. Each epoch visits every record once in shuffled
+* minibatches. Shuffling works on chunks of CHUNK consecutive records: the
+* chunk order is shuffled, then the records within each chunk. A
+* background thread copies batches ahead of the trainer into a ring of
+* buffers, hinting the OS to read in the next chunk as it goes.
+*
+* Layout (version 1, native byte order): a 64 byte Header, then n_records
+* records of n_inputs + n_targets doubles. DatasetWriter makes these files.
+*/
+class StreamingDataset {
+ public:
+    static const uint32_t VERSION = 1;
+    //! records shuffled together as one unit of locality
+    static const size_t CHUNK = 4096;
+
+    struct Header {
+        char magic[8];  // "NNDATA" and terminating zeros
+        uint32_t version;
+        uint32_t n_inputs;
+        uint32_t n_targets;
+        uint32_t reserved;
+        uint64_t n_records;
+        char padding[32];
+    };
+
+    //! One minibatch, its records back to back
+    struct Batch {
+        Batch() : n(0), n_inputs(0), stride(0) {}
+        int n;
+        int n_inputs;
+        int stride;
+        std::vector<double> records;
+
+        const double* input(int i) const { return &records[i*stride]; }
+        const double* target(int i) const {
+            return &records[i*stride + n_inputs];
+        }
+    };
+
+    //! prefetch_batches is how many batches may be ready ahead of the
+    //! trainer; seed fixes the shuffles (epoch k uses seed + k)
+    explicit StreamingDataset(std::string filein, int prefetch_batches = 4,
+        unsigned seed = 0);
+    ~StreamingDataset();
+
+    size_t size() const { return static_cast<size_t>(header_->n_records); }
+    int inputs() const { return static_cast<int>(header_->n_inputs); }
+    int targets() const { return static_cast<int>(header_->n_targets); }
+
+    //! Starts a new shuffled pass over the records, ending any current one
+    void beginEpoch(int batch_size);
+    //! Swaps the next batch of the pass into b; false once the pass is done
+    bool nextBatch(Batch* b);
+
+ private:
+    StreamingDataset(const StreamingDataset &);
+    StreamingDataset &operator=(const StreamingDataset &);
+
+    MappedFile file_;
+    const Header* header_;
+    const double* records_;
+    unsigned seed_;
+    int epoch_;
+    int batch_size_;
+    size_t n_batches_;
+    size_t consumed_;
+
+    //! ring of batches; the prefetch thread fills slots_[(head_ + filled_)
+    //! % size] while the trainer takes slots_[head_]
+    std::vector<Batch> slots_;
+    size_t head_;
+    size_t filled_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread prefetcher_;
+
+    //! body of the prefetch thread: one pass, shuffled with seed
+    void prefetch(unsigned seed);
+    //! waits for a free slot; NULL if the pass is being stopped
+    Batch* acquireSlot();
+    void publishSlot();
+    void stopPrefetch();
+    static void fatal(const std::string &message);
+};
+
+/**
+* Appends fixed-width records to a StreamingDataset file. The record count
+* in the header is brought up to date when the writer is closed.
+*/
+class DatasetWriter {
+ public:
+    //! With append set, adds to fileout if it already holds records of
+    //! this width
+    DatasetWriter(std::string fileout, int n_inputs, int n_targets,
+        bool append = false);
+    ~DatasetWriter() { close(); }
+
+    void append(const double* o, const double* t);
+    void append(const matrix1d &o, const matrix1d &t);
+    size_t size() const { return n_records_; }
+    void close();
+
+ private:
+    DatasetWriter(const DatasetWriter &);
+    DatasetWriter &operator=(const DatasetWriter &);
+
+    FILE* out_;
+    int n_inputs_;
+    int n_targets_;
+    size_t n_records_;
+};
+#endif  // SINGLEAGENT_NEURALNET_STREAMINGDATASET_H_
@@ -2,43 +2,168 @@
 #ifndef SINGLEAGENT_NEURALNET_TYPENEURALNET_H_
 #define SINGLEAGENT_NEURALNET_TYPENEURALNET_H_
 
-
+#include <algorithm>
+#include <vector>
 #include "NeuralNet.h"
+#include "Activation.h"
+#include "DenseKernels.h"
 
-class TypeNeuralNet : public NeuralNet {
+/**
+* Network with a linear preprocessing step for typed states. A state of
+* [type][state element] is mixed into the network's input by
+* preprocessing weights [t][s][k]: input s*mixes() + k is the sum over
+* types t of state[t][s]*preprocess(t, s, k).
+*
+* Being linear, the preprocessing folds into the first layer. When that
+* costs fewer multiplies than mixing first (several mixes per element, as
+* in NeuroEvoTypeCrossweighted), the folded layer is kept, recomputed on
+* mutation, and predictTyped() is one ordinary forward pass over the typed
+* state. Otherwise (one mix, as in NeuroEvoTypeWeighted) the state is
+* mixed on the way in.
+*/
+template <class Scalar>
+class BasicTypeNeuralNet : public BasicNeuralNet<Scalar> {
  public:
-    TypeNeuralNet(int input, int hidden, int output,
-        matrix3d preprocess_weights) :
-        NeuralNet(input, hidden, output),
-        preprocess_weights(preprocess_weights) {
-        for (matrix2d &l1 : preprocess_weights) {
-            for (matrix1d &l2 : l1) {
-                for (double &l3 : l2) {
-                    double fan_in = static_cast<double>
-                        (preprocess_weights.size());
-                    l3 = randSetFanIn(fan_in);
+    typedef typename BasicNeuralNet<Scalar>::WeightView WeightView;
+
+    //! preprocess_weights gives the shape of the preprocessing,
+    //! [type][state element][mix]; the weights themselves are random
+    BasicTypeNeuralNet(int input, int hidden, int output,
+        const matrix3d &preprocess_weights) :
+        BasicNeuralNet<Scalar>(input, hidden, output),
+        n_types_(static_cast<int>(preprocess_weights.size())),
+        n_state_elements_(static_cast<int>(preprocess_weights[0].size())),
+        n_mixes_(static_cast<int>(preprocess_weights[0][0].size())) {
+        if (n_state_elements_*n_mixes_ != input) {
+            printf("TypeNeuralNet: %i state elements x %i mixes do not ",
+                n_state_elements_, n_mixes_);
+            printf("match %i inputs.", input);
+            system("pause");
+            exit(1);
+        }
+        preprocess_.resize(static_cast<size_t>(n_types_)*input);
+        for (Scalar &p : preprocess_) {
+            p = static_cast<Scalar>(this->randSetFanIn(n_types_));
+        }
+
+        double TS = n_types_*n_state_elements_;
+        fuse_ = TS*hidden <= TS*n_mixes_ + static_cast<double>(input)*hidden;
+        input_.resize(fuse_ ? n_types_*n_state_elements_ + 1 : input + 1);
+        int widest = *std::max_element(this->nodes().begin() + 1,
+            this->nodes().end());
+        activations_[0].resize(widest + 1);
+        activations_[1].resize(widest + 1);
+        fuseWeights();
+    }
+
+    int types() const { return n_types_; }
+    int stateElements() const { return n_state_elements_; }
+    int mixes() const { return n_mixes_; }
+    //! whether predictTyped runs the folded first layer
+    bool fused() const { return fuse_; }
+    Scalar &preprocess(int t, int s, int k) {
+        return preprocess_[(t*n_state_elements_ + s)*n_mixes_ + k];
+    }
+
+    //! Action for state [type][state element]
+    matrix1d predictTyped(const matrix2d &state) {
+        int T = n_types_;
+        int S = n_state_elements_;
+        int K = n_mixes_;
+        const std::vector<int> &nodes = this->nodes();
+        Scalar* in = input_.data();
+        const Scalar* W0;
+        if (fuse_) {
+            for (int t = 0; t < T; t++) {
+                std::copy(state[t].begin(), state[t].begin() + S, in + t*S);
+            }
+            W0 = fused_.data();
+        } else {
+            std::fill(in, in + S*K, Scalar(0));
+            for (int t = 0; t < T; t++) {
+                const Scalar* p = &preprocess_[t*S*K];
+                for (int s = 0; s < S; s++) {
+                    Scalar x = static_cast<Scalar>(state[t][s]);
+                    for (int k = 0; k < K; k++) in[s*K + k] += x*p[s*K + k];
                 }
             }
+            W0 = this->Wbar(0).data;
         }
-    }
+        int rows = static_cast<int>(input_.size());
+        in[rows - 1] = 1.0;  // bias
 
-    matrix3d preprocess_weights;  // [t][s][t']
+        Scalar* a = activations_[0].data();
+        this->inputVecmat(in, rows, W0, nodes[1], a);
+        nnkernels::sigmoid(a, nodes[1]);
+        for (int c = 1; c < this->connections(); c++) {
+            Scalar* next = activations_[c % 2].data();
+            a[nodes[c]] = 1.0;
+            nnkernels::vecmat(a, nodes[c] + 1, this->Wbar(c).data,
+                nodes[c + 1], next);
+            nnkernels::sigmoid(next, nodes[c + 1]);
+            a = next;
+        }
+        return matrix1d(a, a + nodes.back());
+    }
 
     void mutate() {
-        NeuralNet::mutate();
+        BasicNeuralNet<Scalar>::mutate();
 
         // now mutate the preprocess weights
-        for (matrix2d &l1 : preprocess_weights) {
-            for (matrix1d &l2 : l1) {
-                for (double &l3 : l2) {
-                    double fan_in
-                        = static_cast<double>(preprocess_weights.size());
-                    l3 += randAddFanIn(fan_in);
-                }
+        for (Scalar &p : preprocess_) {
+            p += static_cast<Scalar>(this->randAddFanIn(n_types_));
+        }
+        fuseWeights();
+    }
+    //! mutate() drawing from rng instead of the net's own stream, so a
+    //! population can mutate its members from its own stream
+    void mutate(easymath::Philox* rng) {
+        BasicNeuralNet<Scalar>::mutate(rng);
+        for (Scalar &p : preprocess_) {
+            p += static_cast<Scalar>(this->randAddFanIn(n_types_, rng));
+        }
+        fuseWeights();
+    }
+
+    //! Refolds the preprocessing into the first layer; call after changing
+    //! the weights other than through mutate()
+    void fuseWeights() {
+        if (!fuse_) return;
+        int TS = n_types_*n_state_elements_;
+        WeightView w0 = this->Wbar(0);
+        int H = w0.cols;
+        fused_.assign(static_cast<size_t>(TS + 1)*H, Scalar(0));
+        for (int ts = 0; ts < TS; ts++) {
+            int s = ts % n_state_elements_;
+            Scalar* row = &fused_[ts*H];
+            for (int k = 0; k < n_mixes_; k++) {
+                Scalar p = preprocess_[ts*n_mixes_ + k];
+                const Scalar* w = w0.row(s*n_mixes_ + k);
+                for (int j = 0; j < H; j++) row[j] += p*w[j];
             }
         }
+        const Scalar* bias = w0.row(w0.rows - 1);
+        std::copy(bias, bias + H, &fused_[TS*H]);
     }
 
-    ~TypeNeuralNet(void) {}
+    ~BasicTypeNeuralNet(void) {}
+
+ private:
+    int n_types_;
+    int n_state_elements_;
+    int n_mixes_;
+    //! [t][s][k], contiguous
+    std::vector<Scalar> preprocess_;
+    //! whether predictTyped uses fused_
+    bool fuse_;
+    //! first layer with the preprocessing folded in: [t*S + s, then the
+    //! bias][hidden unit]
+    easystl::aligned_vector<Scalar> fused_;
+    //! network input plus bias, and alternating layer outputs
+    easystl::aligned_vector<Scalar> input_;
+    easystl::aligned_vector<Scalar> activations_[2];
 };
+
+typedef BasicTypeNeuralNet<double> TypeNeuralNet;
+typedef BasicTypeNeuralNet<float> FloatTypeNeuralNet;
 #endif  // SINGLEAGENT_NEURALNET_TYPENEURALNET_H_
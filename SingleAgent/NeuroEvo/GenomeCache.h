@@ -0,0 +1,143 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEUROEVO_GENOMECACHE_H_
+#define SINGLEAGENT_NEUROEVO_GENOMECACHE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "PopulationArena.h"
+#include "SeedGenome.h"
+
+/**
+* Bounded cache of materialized SeedGenomes. A genome not in the cache is
+* built from its longest cached ancestor, usually its parent, so a child
+* costs one copy and one mutation; only a genome with no cached ancestor
+* is replayed from its initial seed. When full, the least recently used
+* entry is dropped. Weights are kept in a PopulationArena of fixed slots.
+*/
+template <class Net>
+class GenomeCache {
+ public:
+    GenomeCache() : clock_(0), hits_(0), misses_(0), replayed_(0) {}
+    GenomeCache(const Net &prototype, size_t capacity) : clock_(0),
+        hits_(0), misses_(0), replayed_(0) {
+        reset(prototype, capacity);
+    }
+
+    //! Empties the cache and makes room for capacity nets (at least two:
+    //! an ancestor and its descendant) shaped like prototype
+    void reset(const Net &prototype, size_t capacity) {
+        capacity = std::max(capacity, static_cast<size_t>(2));
+        arena_.reset(prototype, capacity);
+        entries_.clear();
+        for (size_t i = 0; i < capacity; i++) {
+            entries_.push_back(Entry(arena_.acquire(prototype)));
+        }
+        index_.clear();
+    }
+
+    //! The weights of genome, valid until the next call to get()
+    Net* get(const SeedGenome &genome) {
+        clock_++;
+        size_t hit = find(genome.key(), genome);
+        if (hit != NONE) {
+            hits_++;
+            entries_[hit].last_used = clock_;
+            return entries_[hit].net;
+        }
+        misses_++;
+
+        // Longest cached ancestor to start from. Touching it keeps it
+        // from being the entry evicted below.
+        genome.prefixKeys(&keys_);
+        size_t base = NONE;
+        size_t from = 0;
+        for (size_t n = genome.generation(); n-- > 0;) {
+            base = findPrefix(keys_[n], genome, n);
+            if (base != NONE) {
+                entries_[base].last_used = clock_;
+                from = n;
+                break;
+            }
+        }
+
+        size_t e = victim();
+        Entry &entry = entries_[e];
+        if (base != NONE) {
+            *entry.net = *entries_[base].net;
+            genome.replay(entry.net, from);
+        } else {
+            genome.materialize(entry.net);
+        }
+        replayed_ += genome.generation() - from;
+        entry.genome = genome;
+        entry.used = true;
+        entry.last_used = clock_;
+        index_[genome.key()] = e;
+        return entry.net;
+    }
+
+    size_t capacity() const { return entries_.size(); }
+    //! get() calls answered from the cache
+    size_t hits() const { return hits_; }
+    //! get() calls that built a net
+    size_t misses() const { return misses_; }
+    //! mutations replayed by those builds
+    size_t replayed() const { return replayed_; }
+
+ private:
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    struct Entry {
+        explicit Entry(Net* net) : net(net), used(false), last_used(0) {}
+        SeedGenome genome;
+        Net* net;
+        bool used;
+        uint64_t last_used;
+    };
+
+    PopulationArena<Net> arena_;
+    std::vector<Entry> entries_;
+    //! genome key -> entry
+    std::unordered_map<uint64_t, size_t> index_;
+    //! scratch for prefix keys
+    std::vector<uint64_t> keys_;
+    uint64_t clock_;
+    size_t hits_;
+    size_t misses_;
+    size_t replayed_;
+
+    size_t find(uint64_t key, const SeedGenome &genome) const {
+        typename std::unordered_map<uint64_t, size_t>::const_iterator it
+            = index_.find(key);
+        if (it == index_.end() || !(entries_[it->second].genome == genome))
+            return NONE;
+        return it->second;
+    }
+    //! entry holding genome's first n mutations
+    size_t findPrefix(uint64_t key, const SeedGenome &genome,
+        size_t n) const {
+        typename std::unordered_map<uint64_t, size_t>::const_iterator it
+            = index_.find(key);
+        if (it == index_.end()) return NONE;
+        const SeedGenome &cached = entries_[it->second].genome;
+        if (cached.generation() != n || !genome.startsWith(cached))
+            return NONE;
+        return it->second;
+    }
+    //! an unused entry, or else the least recently used one, evicted
+    size_t victim() {
+        size_t e = 0;
+        for (size_t i = 0; i < entries_.size(); i++) {
+            if (!entries_[i].used) return i;
+            if (entries_[i].last_used < entries_[e].last_used) e = i;
+        }
+        typename std::unordered_map<uint64_t, size_t>::iterator it
+            = index_.find(entries_[e].genome.key());
+        if (it != index_.end() && it->second == e) index_.erase(it);
+        entries_[e].used = false;
+        return e;
+    }
+};
+#endif  // SINGLEAGENT_NEUROEVO_GENOMECACHE_H_
@@ -0,0 +1,275 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEUROEVO_GENOMENEUROEVO_H_
+#define SINGLEAGENT_NEUROEVO_GENOMENEUROEVO_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "NeuroEvo.h"
+#include "GenomeCache.h"
+#include "SeedGenome.h"
+
+/**
+* Neuro-evolution as in BasicNeuroEvo, but the population holds
+* SeedGenomes rather than networks. Networks are built in a GenomeCache
+* when a member is evaluated, so memory grows with the number of
+* generations instead of the population's weight count. One seed fixes
+* the initial genomes and every mutation and shuffle after them.
+*/
+template <class Net>
+class GenomeNeuroEvo : public INeuroEvo {
+ public:
+    struct Member {
+        explicit Member(const SeedGenome &genome = SeedGenome(),
+            double evaluation = 0.0) : genome(genome),
+            evaluation(evaluation) {}
+        SeedGenome genome;
+        double evaluation;
+    };
+
+    //! cache_size nets are kept built; 0 for 2*popSize
+    GenomeNeuroEvo(NeuroEvoParameters* neuroEvoParamsSet, uint64_t seed = 0,
+        size_t cache_size = 0);
+
+    NeuroEvoParameters* params;
+    //! survivors first, then offspring
+    std::vector<Member> population;
+    size_t member_active;
+
+    void generateNewMembers();
+    bool selectNewMember();
+    double getBestMemberVal();
+    void selectSurvivors();
+    void updatePolicyValues(double R);
+
+    matrix1d getAction(matrix1d state);
+    matrix1d getAction(matrix2d state);
+
+    //! Candidates are built in nets of their own, apart from the cache,
+    //! so they stay valid while other threads evaluate them
+    size_t spawnCandidate();
+    matrix1d getCandidateAction(size_t id, const matrix1d &state) {
+        return candidate_nets_[id]->predictContinuous(state);
+    }
+    void resolveCandidate(size_t id, double R);
+
+    //! Every member is built into a net of its own, apart from the cache,
+    //! which threads cannot share
+    size_t nMembers() { return population.size(); }
+    void prepareMemberActions();
+    matrix1d getMemberAction(size_t m, const matrix1d &state) {
+        return member_nets_[m]->predictContinuous(state);
+    }
+    //! The genome's key, which stands for the weights the seeds make
+    uint64_t memberKey(size_t m) { return population[m].genome.key(); }
+    bool outranked(size_t m, double R, size_t n_final);
+
+    //! Weights of member m, valid until another member is built
+    Net* member(size_t m) {
+        active_net_ = NULL;
+        return cache_.get(population[m].genome);
+    }
+    const GenomeCache<Net> &cache() const { return cache_; }
+
+ private:
+    easymath::Philox rng_;
+    GenomeCache<Net> cache_;
+    //! the active member's net, or NULL until it is next needed
+    Net* active_net_;
+    //! scratch for selectSurvivors
+    std::vector<size_t> ranking_;
+    std::vector<Member> survivors_;
+    //! steady-state candidates by id; a NULL net marks a free id
+    std::vector<Member> candidates_;
+    std::vector<Net*> candidate_nets_;
+    PopulationArena<Net> candidate_arena_;
+    //! whether each candidate is scoring the member with its genome
+    std::vector<bool> scoring_;
+    //! members scored so far in steady-state mode
+    size_t n_scored_;
+    //! nets of the members by index, for getMemberAction
+    std::vector<Net*> member_nets_;
+    PopulationArena<Net> member_arena_;
+
+    uint64_t nextSeed() {
+        uint64_t hi = rng_.word();
+        return (hi << 32) | rng_.word();
+    }
+};
+
+template <class Net>
+GenomeNeuroEvo<Net>::GenomeNeuroEvo(NeuroEvoParameters* neuroEvoParamsSet,
+    uint64_t seed, size_t cache_size) : params(neuroEvoParamsSet),
+    member_active(0), rng_(seed, 0), active_net_(NULL), n_scored_(0) {
+    if (cache_size == 0) cache_size = 2*params->popSize;
+    cache_.reset(Net(params->nInput, params->nHidden, params->nOutput),
+        cache_size);
+    population.reserve(2*params->popSize);
+    for (int i = 0; i < params->popSize; i++) {
+        population.push_back(Member(SeedGenome(nextSeed())));
+    }
+}
+
+template <class Net>
+void GenomeNeuroEvo<Net>::generateNewMembers() {
+    // the child keeps its parent's evaluation
+    for (int i = 0; i < params->popSize; i++) {
+        population.push_back(Member(population[i].genome.child(nextSeed()),
+            population[i].evaluation));
+    }
+}
+
+template <class Net>
+bool GenomeNeuroEvo<Net>::selectNewMember() {
+    active_net_ = NULL;
+    if (++member_active == population.size()) {
+        member_active = 0;
+        return false;
+    }
+    return true;
+}
+
+template <class Net>
+double GenomeNeuroEvo<Net>::getBestMemberVal() {
+    double highest = population.front().evaluation;
+    for (const Member &m : population) {
+        if (highest < m.evaluation) highest = m.evaluation;
+    }
+    return highest;
+}
+
+template <class Net>
+void GenomeNeuroEvo<Net>::selectSurvivors() {
+    // Same ranking as BasicNeuroEvo: highest fitness, ties in order
+    ranking_.resize(population.size());
+    for (size_t i = 0; i < ranking_.size(); i++) ranking_[i] = i;
+    std::sort(ranking_.begin(), ranking_.end(),
+        [this](size_t a, size_t b) {
+        double ea = population[a].evaluation;
+        double eb = population[b].evaluation;
+        return ea > eb || (ea == eb && a < b);
+    });
+    size_t n_keep = std::min(ranking_.size(),
+        static_cast<size_t>(params->popSize));
+    survivors_.clear();
+    for (size_t i = 0; i < n_keep; i++) {
+        survivors_.push_back(population[ranking_[i]]);
+    }
+    // shuffled from the seed, so the order repeats with it
+    for (size_t i = survivors_.size(); i > 1; i--) {
+        std::swap(survivors_[i - 1], survivors_[rng_.word() % i]);
+    }
+    population.swap(survivors_);
+
+    member_active = 0;
+    active_net_ = NULL;
+}
+
+template <class Net>
+void GenomeNeuroEvo<Net>::updatePolicyValues(double R) {
+    Member &active = population[member_active];
+    active.evaluation = runningEvaluation(active.evaluation, R);
+}
+
+template <class Net>
+bool GenomeNeuroEvo<Net>::outranked(size_t m, double R, size_t n_final) {
+    // as BasicNeuroEvo's: members before m win ties
+    double best = runningEvaluation(population[m].evaluation, R);
+    size_t above = 0;
+    for (size_t i = 0; i < n_final && i < m; i++) {
+        if (population[i].evaluation >= best) above++;
+    }
+    return above >= static_cast<size_t>(params->popSize);
+}
+
+template <class Net>
+size_t GenomeNeuroEvo<Net>::spawnCandidate() {
+    if (candidate_nets_.empty()) {
+        candidates_.resize(params->popSize);
+        candidate_nets_.assign(params->popSize, NULL);
+        scoring_.assign(params->popSize, false);
+        candidate_arena_.reset(*member(0), params->popSize);
+    }
+    size_t id = 0;
+    while (id < candidate_nets_.size() && candidate_nets_[id]) id++;
+    if (id == candidate_nets_.size()) {
+        printf("GenomeNeuroEvo: more than %i candidates out at once.",
+            params->popSize);
+        system("pause");
+        exit(1);
+    }
+    if (n_scored_ < population.size()) {
+        size_t m = n_scored_++;
+        candidates_[id] = population[m];
+        candidate_nets_[id] = candidate_arena_.acquire(*member(m));
+        scoring_[id] = true;
+        return id;
+    }
+    size_t a = rng_.word() % population.size();
+    size_t b = rng_.word() % population.size();
+    size_t parent = population[a].evaluation >= population[b].evaluation
+        ? a : b;
+    const Member &p = population[parent];
+    candidates_[id] = Member(p.genome.child(nextSeed()));
+    // the parent's net plus the one new mutation
+    Net* net = candidate_arena_.acquire(*member(parent));
+    candidates_[id].genome.replay(net, p.genome.generation());
+    candidate_nets_[id] = net;
+    scoring_[id] = false;
+    return id;
+}
+
+template <class Net>
+void GenomeNeuroEvo<Net>::resolveCandidate(size_t id, double R) {
+    Member &c = candidates_[id];
+    c.evaluation = R;
+    candidate_arena_.release(candidate_nets_[id]);
+    candidate_nets_[id] = NULL;
+    if (scoring_[id]) {
+        for (Member &m : population) {
+            if (m.genome == c.genome) m.evaluation = c.evaluation;
+        }
+        return;
+    }
+
+    // Tournament against the worst member (the first, on ties)
+    size_t worst = 0;
+    for (size_t i = 1; i < population.size(); i++) {
+        if (population[i].evaluation < population[worst].evaluation)
+            worst = i;
+    }
+    if (c.evaluation >= population[worst].evaluation) {
+        std::swap(population[worst], c);
+        active_net_ = NULL;
+    }
+}
+
+template <class Net>
+void GenomeNeuroEvo<Net>::prepareMemberActions() {
+    for (Net* net : member_nets_) member_arena_.release(net);
+    member_nets_.clear();
+    if (member_arena_.capacity() < population.size()) {
+        member_arena_.reset(*member(0), population.size());
+    }
+    for (size_t m = 0; m < population.size(); m++) {
+        member_nets_.push_back(member_arena_.acquire(*member(m)));
+    }
+}
+
+template <class Net>
+matrix1d GenomeNeuroEvo<Net>::getAction(matrix1d state) {
+    if (!active_net_) active_net_ = member(member_active);
+    return active_net_->predictContinuous(state);
+}
+
+template <class Net>
+matrix1d GenomeNeuroEvo<Net>::getAction(matrix2d state) {
+    matrix1d stateSum(state[0].size(), 0.0);
+    for (size_t i = 0; i < state.size(); i++) {
+        for (size_t j = 0; j < state[i].size(); j++) {
+            stateSum[j] += state[i][j];
+        }
+    }
+    return getAction(stateSum);
+}
+#endif  // SINGLEAGENT_NEUROEVO_GENOMENEUROEVO_H_
@@ -0,0 +1,64 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEUROEVO_INEUROEVO_H_
+#define SINGLEAGENT_NEUROEVO_INEUROEVO_H_
+
+#include <cstdint>
+#include "../IAgent.h"
+
+//! The evolutionary steps a multiagent system drives on each agent,
+//! whatever network type and precision the agent evolves
+class INeuroEvo : public IAgent {
+ public:
+    virtual ~INeuroEvo(void) {}
+
+    //! Generate k new members from existing population
+    virtual void generateNewMembers() = 0;
+    //! Select the next member to test; if cannot be selected, end epoch
+    virtual bool selectNewMember() = 0;
+    //! get the highest evaluation in the group
+    virtual double getBestMemberVal() = 0;
+    virtual void selectSurvivors() = 0;
+
+    //! Steady-state evolution, instead of the generateNewMembers /
+    //! selectSurvivors cycle: candidates are scored one at a time while
+    //! the population stays in use. spawnCandidate and resolveCandidate
+    //! belong to one thread; getCandidateAction may be called from others,
+    //! one per candidate. At most popSize candidates are out at once.
+
+    //! Adds a mutated copy of a parent picked by binary tournament, and
+    //! returns its id. The first popSize candidates are plain copies of
+    //! the members instead, whose scores go to the members themselves.
+    virtual size_t spawnCandidate() = 0;
+    virtual matrix1d getCandidateAction(size_t id, const matrix1d &state)
+        = 0;
+    //! Gives the candidate evaluation R. It replaces the worst member if
+    //! that is no better; otherwise it is dropped. Evaluations are single
+    //! rewards here, not updatePolicyValues' running averages, so that
+    //! candidates and members compare like for like.
+    virtual void resolveCandidate(size_t id, double R) = 0;
+
+    //! Generational evaluation on several threads: after
+    //! prepareMemberActions, getMemberAction(m, state) is what member m
+    //! would do as the active member, and may be called from other
+    //! threads, one per member, until the population next changes.
+    virtual size_t nMembers() = 0;
+    virtual void prepareMemberActions() {}
+    virtual matrix1d getMemberAction(size_t m, const matrix1d &state) = 0;
+    //! Identifies member m's policy: members of the population with equal
+    //! keys act alike, so a result can be reused (SimNE's fitness cache).
+    //! 0 if the member has no key.
+    virtual uint64_t memberKey(size_t) { return 0; }
+    //! Racing: whether member m, rewarded no more than R this epoch, is
+    //! sure to be dropped by selectSurvivors, being outranked by popSize
+    //! of members 0 .. n_final - 1, whose rewards are in. False if that
+    //! cannot be known.
+    virtual bool outranked(size_t, double, size_t) { return false; }
+
+ protected:
+    //! A member's evaluation V after being rewarded R: a running average
+    static double runningEvaluation(double V, double R) {
+        double xi = 0.1;  // "learning rate" for NE
+        return xi*(R - V) + V;
+    }
+};
+#endif  // SINGLEAGENT_NEUROEVO_INEUROEVO_H_
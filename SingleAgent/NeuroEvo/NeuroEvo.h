@@ -5,47 +5,67 @@
 #include <set>
 #include <utility>
 #include <algorithm>
-#include <list>
 #include <string>
+#include <iterator>
+#include <vector>
 
 #include "../NeuralNet/NeuralNet.h"
-#include "../IAgent.h"
+#include "../NeuralNet/PopulationTensor.h"
+#include "../NeuralNet/QuantizedNeuralNet.h"
+#include "INeuroEvo.h"
+#include "PopulationArena.h"
 #include "../../FileIO/FileIn.h"
 #include "../../FileIO/FileOut.h"
 
 class NeuroEvoParameters {
  public:
-    NeuroEvoParameters(int inputSet, int outputSet);
+    //! scalar type the population's networks store and compute in
+    enum Precision { DOUBLE, FLOAT };
+
+    NeuroEvoParameters(int inputSet, int outputSet,
+        Precision precision = DOUBLE);
     static const int nHidden = 50;
     static const int popSize = 10;  // surviving population size
 
     int nInput;
     int nOutput;
     double epsilon;  // for epsilon-greedy selection: currently unused
+    Precision precision;
 };
 
-class NeuroEvo : public IAgent {
+//! Neuro-evolution over a population of Net, which needs the
+//! BasicNeuralNet interface: a (input, hidden, output) constructor, copy,
+//! mutate(), evaluation, predictContinuous and save/load. Members live in
+//! a PopulationArena: reproduction copies a parent into a free slot and
+//! selection permutes the member pointers, so a generation allocates
+//! nothing once the population is made.
+template <class Net>
+class BasicNeuroEvo : public INeuroEvo {
  public:
-    NeuroEvo() {}
-    explicit NeuroEvo(NeuroEvoParameters* neuroEvoParamsSet);
-    ~NeuroEvo(void);
+    typedef typename Net::scalar_type scalar_type;
+
+    BasicNeuroEvo() : quantized_inference_(false), tensor_stale_(true),
+        quantized_stale_(true), n_scored_(0) {}
+    explicit BasicNeuroEvo(NeuroEvoParameters* neuroEvoParamsSet);
+    ~BasicNeuroEvo(void);
 
     // Class variables
     NeuroEvoParameters* params;
-    std::list<NeuralNet*> population;
-    std::list<NeuralNet*>::iterator pop_member_active;
+    //! members in evaluation order; survivors first, then offspring
+    std::vector<Net*> population;
+    typename std::vector<Net*>::iterator pop_member_active;
 
-    void deepCopy(const NeuroEvo &NE);
-    //! deletes all neural network population member pointers
+    void deepCopy(const BasicNeuroEvo &NE);
+    //! frees all population members
     void deletePopulation();
     //! Generate k new members from existing population
-    void generateNewMembers();
+    virtual void generateNewMembers();
     //! Select the next member to test; if cannot be selected, end epoch
     bool selectNewMember();
     //! get the highest evaluation in the group
     double getBestMemberVal();
     void selectSurvivors();
-    static bool NNCompare(const NeuralNet *x, const NeuralNet *y) {
+    static bool NNCompare(const Net *x, const Net *y) {
         return (x->evaluation > y->evaluation);
     }
 
@@ -54,10 +74,45 @@ class NeuroEvo : public IAgent {
     matrix1d getAction(matrix1d state);
     matrix1d getAction(matrix2d state);
 
+    size_t spawnCandidate();
+    matrix1d getCandidateAction(size_t id, const matrix1d &state) {
+        return candidates_[id]->predictContinuous(state);
+    }
+    void resolveCandidate(size_t id, double R);
+
+    //! Each member runs its own net, or its int8 copy (made here, once)
+    size_t nMembers() { return population.size(); }
+    void prepareMemberActions() {
+        if (quantized_inference_ && quantized_stale_) quantizePopulation();
+    }
+    matrix1d getMemberAction(size_t m, const matrix1d &state) {
+        if (quantized_inference_) return quantized_[m].predictContinuous(state);
+        return population[m]->predictContinuous(state);
+    }
+    uint64_t memberKey(size_t m) { return population[m]->weightHash(); }
+    bool outranked(size_t m, double R, size_t n_final);
+
+    //! Population tensor mode: every member packed for one fused forward
+    //! pass. Repacked on demand after the population changes here; call
+    //! stackPopulation() after changing member weights from outside.
+    BasicPopulationTensor<scalar_type> population_tensor;
+    void stackPopulation();
+    //! One state per member, in population order: [member][action]
+    matrix2d getPopulationActions(const matrix2d &states);
+    //! The same state through every member: [member][action]
+    matrix2d getPopulationActions(const matrix1d &state);
+
+    //! Quantized inference mode: getAction runs int8 copies of the members
+    //! (QuantizedNeuralNet), remade whenever the population changes here.
+    //! For evaluation-only sweeps; the members themselves are untouched.
+    void setQuantizedInference(bool on) { quantized_inference_ = on; }
+    bool quantizedInference() const { return quantized_inference_; }
+    //! Worst drift of the int8 copies from their members over states
+    QuantizedNeuralNet::Drift quantizationDrift(const matrix2d &states);
 
     void save(std::string fileout) {
         matrix2d nets;
-        for (NeuralNet* p : population) {
+        for (Net* p : population) {
             matrix1d node_info;
             matrix1d wt_info;
             p->save(&node_info, &wt_info);
@@ -72,12 +127,334 @@ class NeuroEvo : public IAgent {
         matrix2d netinfo = FileIn::read2<double>(filein);
 
         int i = 0;
-        for (NeuralNet* p : population) {
+        for (Net* p : population) {
             // assume that population already has the correct size
             p->load(netinfo[i], netinfo[i + 1]);
             i += 2;
         }
+        populationChanged();
+    }
+
+    //! Whole population as one binary ModelFile, evaluations included
+    void saveBinary(std::string fileout) {
+        ModelFile::write(fileout, population);
+    }
+
+    //! Replaces the population with the members of a binary ModelFile
+    void loadBinary(std::string filein) {
+        ModelFile file(filein);
+        deletePopulation();
+        Net prototype(params->nInput, params->nHidden, params->nOutput);
+        if (arena_.capacity() < file.size()) {
+            arena_.reset(prototype, std::max(file.size(),
+                static_cast<size_t>(2*params->popSize)));
+        }
+        for (size_t i = 0; i < file.size(); i++) {
+            population.push_back(arena_.acquire(prototype));
+            population.back()->load(file, i);
+        }
+        pop_member_active = population.begin();
+        populationChanged();
+    }
+
+ protected:
+    //! Marks the population tensor and quantized copies out of date; call
+    //! after adding, removing or reordering members
+    void populationChanged() {
+        tensor_stale_ = true;
+        quantized_stale_ = true;
+    }
+    //! draws for parent tournaments and mutations
+    easymath::UniqueStream rng_;
+
+ private:
+    bool quantized_inference_;
+    bool tensor_stale_;
+    bool quantized_stale_;
+    //! storage for the members; any not in it were added on the heap
+    PopulationArena<Net> arena_;
+    //! scratch for selectSurvivors
+    std::vector<size_t> ranking_;
+    std::vector<Net*> survivors_;
+    //! steady-state candidates by id; NULL where an id is free
+    std::vector<Net*> candidates_;
+    //! whether each candidate is a copy scoring a member, and which one:
+    //! NULL once that member is gone, as its slot may hold another by then
+    std::vector<bool> rescoring_;
+    std::vector<Net*> scoring_;
+    //! members scored so far in steady-state mode
+    size_t n_scored_;
+    void freeMember(Net* member) {
+        for (size_t id = 0; id < scoring_.size(); id++) {
+            if (scoring_[id] == member) scoring_[id] = NULL;
+        }
+        arena_.release(member);
     }
+    //! int8 copies of the members, in population order
+    std::vector<QuantizedNeuralNet> quantized_;
+    void quantizePopulation();
 };
-#endif  // SINGLEAGENT_NEUROEVO_NEUROEVO_H_
 
+typedef BasicNeuroEvo<NeuralNet> NeuroEvo;
+typedef BasicNeuroEvo<FloatNeuralNet> FloatNeuroEvo;
+
+//! A NeuroEvo or FloatNeuroEvo, as params->precision asks
+INeuroEvo* newNeuroEvo(NeuroEvoParameters* params);
+
+template <class Net>
+void BasicNeuroEvo<Net>::updatePolicyValues(double R) {
+    Net* active = *pop_member_active;
+    active->evaluation = runningEvaluation(active->evaluation, R);
+}
+
+template <class Net>
+bool BasicNeuroEvo<Net>::outranked(size_t m, double R, size_t n_final) {
+    // the most m can score; members before it win ties in the ranking
+    double best = runningEvaluation(population[m]->evaluation, R);
+    size_t above = 0;
+    for (size_t i = 0; i < n_final && i < m; i++) {
+        if (population[i]->evaluation >= best) above++;
+    }
+    return above >= static_cast<size_t>(params->popSize);
+}
+
+template <class Net>
+size_t BasicNeuroEvo<Net>::spawnCandidate() {
+    // Sized once, so ids stay put for threads reading candidates_
+    if (candidates_.empty()) {
+        candidates_.assign(params->popSize, NULL);
+        rescoring_.assign(params->popSize, false);
+        scoring_.assign(params->popSize, NULL);
+    }
+    size_t id = 0;
+    while (id < candidates_.size() && candidates_[id]) id++;
+    if (id == candidates_.size()) {
+        printf("NeuroEvo: more than %i candidates out at once.",
+            params->popSize);
+        system("pause");
+        exit(1);
+    }
+    if (n_scored_ < population.size()) {
+        // a copy, so that the member can be replaced while it is out
+        Net* member = population[n_scored_++];
+        candidates_[id] = arena_.acquire(*member);
+        rescoring_[id] = true;
+        scoring_[id] = member;
+        return id;
+    }
+    Net* a = population[rng_.word() % population.size()];
+    Net* b = population[rng_.word() % population.size()];
+    Net* c = arena_.acquire(a->evaluation >= b->evaluation ? *a : *b);
+    c->mutate(&rng_);
+    candidates_[id] = c;
+    rescoring_[id] = false;
+    scoring_[id] = NULL;
+    return id;
+}
+
+template <class Net>
+void BasicNeuroEvo<Net>::resolveCandidate(size_t id, double R) {
+    Net* c = candidates_[id];
+    candidates_[id] = NULL;
+    c->evaluation = R;
+    if (rescoring_[id]) {
+        if (scoring_[id]) scoring_[id]->evaluation = R;
+        scoring_[id] = NULL;
+        arena_.release(c);
+        return;
+    }
+
+    // Tournament against the worst member (the first, on ties)
+    size_t worst = 0;
+    for (size_t i = 1; i < population.size(); i++) {
+        if (population[i]->evaluation < population[worst]->evaluation)
+            worst = i;
+    }
+    if (c->evaluation >= population[worst]->evaluation) {
+        freeMember(population[worst]);
+        population[worst] = c;
+        populationChanged();
+    } else {
+        arena_.release(c);
+    }
+}
+
+template <class Net>
+matrix1d BasicNeuroEvo<Net>::getAction(matrix1d state) {
+    if (quantized_inference_) {
+        if (quantized_stale_) quantizePopulation();
+        size_t m = std::distance(population.begin(), pop_member_active);
+        return quantized_[m].predictContinuous(state);
+    }
+    return (*pop_member_active)->predictContinuous(state);
+}
+
+template <class Net>
+matrix1d BasicNeuroEvo<Net>::getAction(matrix2d state) {
+    matrix1d stateSum(state[0].size(), 0.0);
+
+    // state[type][state_element] -- specifies combination for state
+    for (size_t i = 0; i < state.size(); i++) {
+        for (size_t j = 0; j < state[i].size(); j++) {
+            stateSum[j] += state[i][j];
+        }
+    }
+
+    return getAction(stateSum);
+}
+
+template <class Net>
+void BasicNeuroEvo<Net>::stackPopulation() {
+    population_tensor.pack(population);
+    tensor_stale_ = false;
+}
+
+template <class Net>
+matrix2d BasicNeuroEvo<Net>::getPopulationActions(const matrix2d &states) {
+    if (tensor_stale_) stackPopulation();
+    return population_tensor.predict(states);
+}
+
+template <class Net>
+matrix2d BasicNeuroEvo<Net>::getPopulationActions(const matrix1d &state) {
+    if (tensor_stale_) stackPopulation();
+    return population_tensor.predictAll(state);
+}
+
+template <class Net>
+void BasicNeuroEvo<Net>::quantizePopulation() {
+    quantized_.clear();
+    for (Net* p : population) {
+        quantized_.push_back(QuantizedNeuralNet(*p));
+    }
+    quantized_stale_ = false;
+}
+
+template <class Net>
+QuantizedNeuralNet::Drift BasicNeuroEvo<Net>::quantizationDrift(
+    const matrix2d &states) {
+    if (quantized_stale_) quantizePopulation();
+    QuantizedNeuralNet::Drift worst = { 0.0, 0.0 };
+    size_t m = 0;
+    for (Net* p : population) {
+        QuantizedNeuralNet::Drift d = quantized_[m++].drift(*p, states);
+        worst.max_abs = std::max(worst.max_abs, d.max_abs);
+        worst.mean_abs = std::max(worst.mean_abs, d.mean_abs);
+    }
+    return worst;
+}
+
+template <class Net>
+BasicNeuroEvo<Net>::BasicNeuroEvo(NeuroEvoParameters* neuroEvoParamsSet) :
+    quantized_inference_(false), tensor_stale_(true),
+    quantized_stale_(true), n_scored_(0) {
+    params = neuroEvoParamsSet;
+    population.reserve(2*params->popSize);
+    for (int i = 0; i < params->popSize; i++) {
+        Net nn(params->nInput, params->nHidden, params->nOutput);
+        // room for the survivors and one offspring each
+        if (i == 0) arena_.reset(nn, 2*params->popSize);
+        population.push_back(arena_.acquire(nn));
+    }
+    pop_member_active = population.begin();
+}
+
+template <class Net>
+void BasicNeuroEvo<Net>::deletePopulation() {
+    for (Net* p : population) freeMember(p);
+    population.clear();
+    pop_member_active = population.begin();
+    populationChanged();
+}
+
+template <class Net>
+BasicNeuroEvo<Net>::~BasicNeuroEvo(void) {
+    deletePopulation();
+}
+
+template <class Net>
+bool BasicNeuroEvo<Net>::selectNewMember() {
+    ++pop_member_active;
+    if (pop_member_active == population.end()) {
+        pop_member_active = population.begin();
+        return false;
+    } else {
+        return true;
+    }
+}
+
+template <class Net>
+void BasicNeuroEvo<Net>::generateNewMembers() {
+    // Mutate existing members to generate more
+    size_t active = pop_member_active - population.begin();
+    for (int i = 0; i < params->popSize; i++) {  // add k new members
+        // the copy keeps the parent's evaluation. Mutations draw from the
+        // population's stream, as a copy's own is numbered by when it is
+        // made, which threads would reorder.
+        Net* m = arena_.acquire(*population[i]);
+        m->mutate(&rng_);
+        population.push_back(m);
+    }
+    pop_member_active = population.begin() + active;
+    populationChanged();
+}
+
+template <class Net>
+double BasicNeuroEvo<Net>::getBestMemberVal() {
+    // Find the HIGHEST FITNESS value of any neural network
+    double highest = population.front()->evaluation;
+    for (Net* p : population) {
+        if (highest < p->evaluation) highest = p->evaluation;
+    }
+    return highest;
+}
+
+template <class Net>
+void BasicNeuroEvo<Net>::selectSurvivors() {
+    // Select neural networks with the HIGHEST FITNESS: rank by index,
+    // ties in population order, so a run repeats exactly
+    ranking_.resize(population.size());
+    for (size_t i = 0; i < ranking_.size(); i++) ranking_[i] = i;
+    std::sort(ranking_.begin(), ranking_.end(),
+        [this](size_t a, size_t b) {
+        double ea = population[a]->evaluation;
+        double eb = population[b]->evaluation;
+        return ea > eb || (ea == eb && a < b);
+    });
+    size_t n_keep = std::min(ranking_.size(),
+        static_cast<size_t>(params->popSize));
+    survivors_.clear();
+    for (size_t i = 0; i < n_keep; i++) {
+        survivors_.push_back(population[ranking_[i]]);
+    }
+    for (size_t i = n_keep; i < ranking_.size(); i++) {  // Remove the extra
+        freeMember(population[ranking_[i]]);
+    }
+    // shuffled from the population's stream, so the order repeats with it
+    for (size_t i = survivors_.size(); i > 1; i--) {
+        std::swap(survivors_[i - 1], survivors_[rng_.word() % i]);
+    }
+    population.swap(survivors_);
+
+    pop_member_active = population.begin();
+    populationChanged();
+}
+
+
+template <class Net>
+void BasicNeuroEvo<Net>::deepCopy(const BasicNeuroEvo &NE) {
+    // Creates new pointer addresses for the neural nets
+    params = NE.params;
+
+    deletePopulation();
+    if (arena_.capacity() < NE.population.size()) {
+        arena_.reset(*NE.population.front(), std::max(NE.population.size(),
+            static_cast<size_t>(2*params->popSize)));
+    }
+    for (Net* p : NE.population) {
+        population.push_back(arena_.acquire(*p));
+    }
+    pop_member_active = population.begin();
+    populationChanged();
+}
+#endif  // SINGLEAGENT_NEUROEVO_NEUROEVO_H_
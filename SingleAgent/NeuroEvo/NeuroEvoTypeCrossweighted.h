@@ -2,7 +2,6 @@
 #ifndef SINGLEAGENT_NEUROEVO_NEUROEVOTYPECROSSWEIGHTED_H_
 #define SINGLEAGENT_NEUROEVO_NEUROEVOTYPECROSSWEIGHTED_H_
 
-#include <list>
 #include "NeuroEvo.h"
 #include "../../SingleAgent/NeuralNet/TypeNeuralNet.h"
 
@@ -30,32 +29,23 @@ class NeuroEvoTypeCrossweighted : public NeuroEvo {
 
     virtual void generateNewMembers() {
         // Mutate existing members to generate more
-        std::list<NeuralNet*>::iterator popMember = population.begin();
+        size_t active = pop_member_active - population.begin();
         for (int i = 0; i < params->popSize; i++) {  // add k new members
-            // (*popMember)->evaluation = 0.0;  // commented out so that you take parent's evaluation
-            TypeNeuralNet* m = new TypeNeuralNet(*reinterpret_cast<TypeNeuralNet*>(*popMember));  // dereference pointer AND iterator
-            m->mutate();
+            // population[i]->evaluation = 0.0;  // commented out so that you take parent's evaluation
+            TypeNeuralNet* m = new TypeNeuralNet(*static_cast<TypeNeuralNet*>(population[i]));
+            m->mutate(&rng_);
             population.push_back(m);
-            ++popMember;
         }
+        pop_member_active = population.begin() + active;
+        populationChanged();
     }
 
     using NeuroEvo::getAction;  // so that the overloaded base function is seen
 
     matrix1d getAction(matrix2d state) {
-        matrix1d preprocessed_state(n_state_elements*n_types, 0.0);
-        int ind = 0;  // index for state;
-        // freaky for loop makes math right
-        for (int s = 0; s < n_state_elements; s++) {
-            for (size_t t_prime = 0; t_prime < (reinterpret_cast<TypeNeuralNet*>(*pop_member_active))->preprocess_weights[0][0].size(); t_prime++) {
-                double node_sum = 0.0;
-                for (int t = 0; t < n_types; t++) {
-                    node_sum += state[t][s] * (reinterpret_cast<TypeNeuralNet*>(*pop_member_active))->preprocess_weights[t][s][t_prime];
-                }
-                preprocessed_state[ind++] = node_sum;
-            }
-        }
-        return getAction(preprocessed_state);
+        // preprocessing is folded into the first layer (see TypeNeuralNet)
+        return static_cast<TypeNeuralNet*>(*pop_member_active)
+            ->predictTyped(state);
     }
 };
 #endif  // SINGLEAGENT_NEUROEVO_NEUROEVOTYPECROSSWEIGHTED_H_
@@ -2,7 +2,6 @@
 #ifndef SINGLEAGENT_NEUROEVO_NEUROEVOTYPEWEIGHTED_H_
 #define SINGLEAGENT_NEUROEVO_NEUROEVOTYPEWEIGHTED_H_
 
-#include <list>
 #include "NeuroEvo.h"
 #include "../NeuralNet/TypeNeuralNet.h"
 
@@ -33,19 +32,19 @@ class NeuroEvoTypeWeighted : public NeuroEvo {
 
     virtual void generateNewMembers() {
         // Mutate existing members to generate more
-        std::list<NeuralNet*>::iterator popMember = population.begin();
+        size_t active = pop_member_active - population.begin();
         // add k new members
         for (int i = 0; i < params->popSize; i++) {
             // commented out so that you take parent's evaluation
-            // (*popMember)->evaluation = 0.0;
-            // dereference pointer AND iterator
+            // population[i]->evaluation = 0.0;
             TypeNeuralNet* m
-                = new TypeNeuralNet(*reinterpret_cast<TypeNeuralNet*>
-                    (*popMember));
-            m->mutate();
+                = new TypeNeuralNet(*static_cast<TypeNeuralNet*>
+                    (population[i]));
+            m->mutate(&rng_);
             population.push_back(m);
-            ++popMember;
         }
+        pop_member_active = population.begin() + active;
+        populationChanged();
     }
 
     int n_types, n_state_elements;
@@ -54,15 +53,8 @@ class NeuroEvoTypeWeighted : public NeuroEvo {
 
     matrix1d getAction(matrix2d state) {
         // state has elements [type][state element]
-        matrix1d preprocessed_state(n_state_elements, 0.0);
-        for (int s = 0; s < n_state_elements; s++) {
-            for (int t = 0; t < n_types; t++) {
-                preprocessed_state[s] += state[t][s]
-                    * (reinterpret_cast<TypeNeuralNet*>
-                        (*pop_member_active))->preprocess_weights[t][s][0];
-            }
-        }
-        return getAction(preprocessed_state);
+        return static_cast<TypeNeuralNet*>(*pop_member_active)
+            ->predictTyped(state);
     }
 
     ~NeuroEvoTypeWeighted() {}
@@ -0,0 +1,92 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEUROEVO_POPULATIONARENA_H_
+#define SINGLEAGENT_NEUROEVO_POPULATIONARENA_H_
+
+#include <vector>
+#include "../../STL/AlignedAllocator.h"
+
+/**
+* Fixed pool of population members for BasicNeuroEvo. Every slot is made
+* once, up front, from a prototype, and the slots' weights are bound into
+* one aligned arena at a fixed stride, so the population's weights sit in
+* a single block for the whole run. acquire() copies a member into a free
+* slot: for a net of the prototype's shape that is a copy of values into
+* storage that is already sized, so reproduction allocates nothing and
+* long runs do not fragment the heap. Nets that keep their weights inline
+* (FixedNeuralNet) are not bound; the slot array is contiguous already.
+* Once every slot is in use, acquire() puts copies on the heap instead,
+* and release() deletes them.
+*/
+template <class Net>
+class PopulationArena {
+ public:
+    typedef typename Net::scalar_type Scalar;
+
+    PopulationArena() : stride_(0) {}
+
+    //! Makes capacity free slots shaped like prototype. Members acquired
+    //! before are invalidated.
+    void reset(const Net &prototype, size_t capacity) {
+        slots_.assign(capacity, prototype);
+        stride_ = weightCount(prototype, 0);
+        arena_.assign(capacity*stride_, 0.0);
+        for (size_t s = 0; s < capacity; s++) {
+            bind(&slots_[s], arena_.data() + s*stride_, 0);
+        }
+        // handed out from the back, so slot 0 goes first
+        free_.clear();
+        for (size_t s = capacity; s > 0; s--) free_.push_back(s - 1);
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t available() const { return free_.size(); }
+    //! true if member is one of this arena's slots
+    bool owns(const Net* member) const {
+        return !slots_.empty() && member >= &slots_.front()
+            && member <= &slots_.back();
+    }
+
+    //! Copies source into a free slot and returns it; a heap copy if
+    //! there is none
+    Net* acquire(const Net &source) {
+        if (free_.empty()) return new Net(source);
+        Net* slot = &slots_[free_.back()];
+        free_.pop_back();
+        *slot = source;
+        return slot;
+    }
+    //! Returns member's slot to the pool, or deletes it if it has none
+    void release(Net* member) {
+        if (owns(member))
+            free_.push_back(static_cast<size_t>(member - &slots_.front()));
+        else
+            delete member;
+    }
+
+    //! All slots' weights; slot s starts at s*stride()
+    const Scalar* weights() const { return arena_.data(); }
+    size_t stride() const { return stride_; }
+
+ private:
+    std::vector<Net> slots_;
+    easystl::aligned_vector<Scalar> arena_;
+    //! free slot indices, used as a stack
+    std::vector<size_t> free_;
+    size_t stride_;
+
+    // Nets with bindWeights() get arena storage; the rest keep their own
+    template <class N>
+    static auto weightCount(const N &net, int) -> decltype(net.weightCount()) {
+        return net.weightCount();
+    }
+    template <class N>
+    static size_t weightCount(const N &, long) { return 0; }
+    template <class N>
+    static auto bind(N* net, Scalar* slot, int)
+        -> decltype(net->bindWeights(slot)) {
+        net->bindWeights(slot);
+    }
+    template <class N>
+    static void bind(N*, Scalar*, long) {}
+};
+#endif  // SINGLEAGENT_NEUROEVO_POPULATIONARENA_H_
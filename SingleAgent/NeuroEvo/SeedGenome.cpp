@@ -0,0 +1,61 @@
+// Copyright 2016 Carrie Rebhuhn
+#include "SeedGenome.h"
+#include <algorithm>
+#include <vector>
+
+using std::vector;
+
+SeedGenome::SeedGenome(uint64_t init_seed) : init_seed_(init_seed),
+    key_(mix(0, init_seed)) {
+}
+
+SeedGenome::SeedGenome(const vector<uint64_t> &words) :
+    init_seed_(words.empty() ? 0 : words[0]), key_(mix(0, init_seed_)) {
+    for (size_t i = 1; i < words.size(); i++) {
+        mutations_.push_back(words[i]);
+        key_ = mix(key_, words[i]);
+    }
+}
+
+SeedGenome SeedGenome::child(uint64_t mutation_seed) const {
+    SeedGenome c(*this);
+    c.mutations_.push_back(mutation_seed);
+    c.key_ = mix(key_, mutation_seed);
+    return c;
+}
+
+void SeedGenome::prefixKeys(vector<uint64_t>* keys) const {
+    keys->resize(mutations_.size() + 1);
+    uint64_t k = mix(0, init_seed_);
+    (*keys)[0] = k;
+    for (size_t m = 0; m < mutations_.size(); m++) {
+        k = mix(k, mutations_[m]);
+        (*keys)[m + 1] = k;
+    }
+}
+
+bool SeedGenome::startsWith(const SeedGenome &prefix) const {
+    return init_seed_ == prefix.init_seed_
+        && prefix.mutations_.size() <= mutations_.size()
+        && std::equal(prefix.mutations_.begin(), prefix.mutations_.end(),
+            mutations_.begin());
+}
+
+bool SeedGenome::operator==(const SeedGenome &other) const {
+    return key_ == other.key_ && init_seed_ == other.init_seed_
+        && mutations_ == other.mutations_;
+}
+
+vector<uint64_t> SeedGenome::words() const {
+    vector<uint64_t> w(1, init_seed_);
+    w.insert(w.end(), mutations_.begin(), mutations_.end());
+    return w;
+}
+
+uint64_t SeedGenome::mix(uint64_t key, uint64_t seed) {
+    // splitmix64's finalizer over the running key and the next seed
+    uint64_t z = key*0x9E3779B97F4A7C15ull + seed + 0x632BE59BD9B4E019ull;
+    z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
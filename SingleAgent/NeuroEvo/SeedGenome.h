@@ -0,0 +1,69 @@
+// Copyright 2016 Carrie Rebhuhn
+#ifndef SINGLEAGENT_NEUROEVO_SEEDGENOME_H_
+#define SINGLEAGENT_NEUROEVO_SEEDGENOME_H_
+
+#include <cstdint>
+#include <vector>
+#include "../../Math/Philox.h"
+
+/**
+* A network stored as the seeds that made it: the seed of its initial
+* weights and one seed per mutation since. Offspring differ from their
+* parent by a single mutation, so a genome costs 8 bytes per generation
+* instead of a copy of every weight, and fits in a short message. The
+* weights are rebuilt by replaying the seeds (materialize), which depends
+* on the net's shape, mutationRate and mutStd staying as they were when
+* the genome was made.
+*/
+class SeedGenome {
+ public:
+    explicit SeedGenome(uint64_t init_seed = 0);
+    //! Flat form from words(): the init seed, then the mutation seeds
+    explicit SeedGenome(const std::vector<uint64_t> &words);
+
+    //! This genome plus one mutation drawn under mutation_seed
+    SeedGenome child(uint64_t mutation_seed) const;
+
+    uint64_t initSeed() const { return init_seed_; }
+    const std::vector<uint64_t> &mutations() const { return mutations_; }
+    //! mutations since the initial weights
+    size_t generation() const { return mutations_.size(); }
+    //! Hash of the whole chain
+    uint64_t key() const { return key_; }
+    //! keys->at(n) gets the key of the genome's first n mutations, for
+    //! n = 0 .. generation()
+    void prefixKeys(std::vector<uint64_t>* keys) const;
+    //! true if prefix's seeds begin this genome's
+    bool startsWith(const SeedGenome &prefix) const;
+    bool operator==(const SeedGenome &other) const;
+
+    std::vector<uint64_t> words() const;
+
+    //! Rebuilds the genome's weights in net, which keeps its shape
+    template <class Net>
+    void materialize(Net* net) const {
+        easymath::Philox rng(init_seed_, INIT_STREAM);
+        net->randomize(&rng);
+        replay(net, 0);
+    }
+    //! Applies mutations first .. generation() - 1 to net
+    template <class Net>
+    void replay(Net* net, size_t first) const {
+        for (size_t m = first; m < mutations_.size(); m++) {
+            easymath::Philox rng(mutations_[m], MUTATION_STREAM);
+            net->mutate(&rng);
+        }
+    }
+
+ private:
+    static const uint64_t INIT_STREAM = 0;
+    static const uint64_t MUTATION_STREAM = 1;
+
+    uint64_t init_seed_;
+    std::vector<uint64_t> mutations_;
+    uint64_t key_;
+
+    //! key of a chain extended by seed
+    static uint64_t mix(uint64_t key, uint64_t seed);
+};
+#endif  // SINGLEAGENT_NEUROEVO_SEEDGENOME_H_
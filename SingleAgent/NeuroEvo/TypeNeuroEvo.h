@@ -8,15 +8,15 @@
 
 #include "NeuroEvo.h"
 #include "../../Math/easymath.h"
-#include "../IAgent.h"
+#include "INeuroEvo.h"
 
-class TypeNeuroEvo : public IAgent {
+class TypeNeuroEvo : public INeuroEvo {
  public:
     TypeNeuroEvo(void);
     TypeNeuroEvo(NeuroEvoParameters* NEParams, int nTypes) :
         NETypes(std::vector<NeuroEvo*>(nTypes)),
         xi(matrix1d(nTypes, 0.0)) {
-        for (NeuroEvo* ne : NETypes) {
+        for (NeuroEvo* &ne : NETypes) {
             ne = new NeuroEvo(NEParams);
         }
     }
@@ -69,6 +69,13 @@ class TypeNeuroEvo : public IAgent {
         }
     }
 
+    bool selectNewMember() { return selectNewMemberAll(); }
+    double getBestMemberVal() {
+        matrix1d vals = getBestMemberValAll();
+        return *std::max_element(vals.begin(), vals.end());
+    }
+    void selectSurvivors() { selectSurvivorsAll(); }
+
     matrix1d getAction(matrix1d state) {
         printf("GetAction being called in multimind setting. Need ");
         printf("neighbor_type identification, or else this will not work. ");
@@ -104,6 +111,26 @@ class TypeNeuroEvo : public IAgent {
         return action_sum;
     }
 
+    size_t spawnCandidate() {
+        steadyStateUnsupported();
+        return 0;
+    }
+    matrix1d getCandidateAction(size_t, const matrix1d &) {
+        steadyStateUnsupported();
+        return matrix1d();
+    }
+    void resolveCandidate(size_t, double) { steadyStateUnsupported(); }
+
+    size_t nMembers() { return NETypes.front()->nMembers(); }
+    matrix1d getMemberAction(size_t, const matrix1d &) {
+        printf("Member actions are not supported in the multimind ");
+        printf("setting: a member acts on each type's state in turn, ");
+        printf("and its votes would have to count towards xi.");
+        std::system("pause");
+        exit(10);
+        return matrix1d();
+    }
+
     // eligibility trace: count of how many times each neural net used in run
     matrix1d xi;
 
@@ -122,5 +149,13 @@ class TypeNeuroEvo : public IAgent {
     }
 
     ~TypeNeuroEvo(void);
+
+ private:
+    void steadyStateUnsupported() {
+        printf("Steady-state evolution is not supported in the multimind ");
+        printf("setting: candidates would need a member of every type.");
+        std::system("pause");
+        exit(10);
+    }
 };
 #endif  // SINGLEAGENT_NEUROEVO_TYPENEUROEVO_H_